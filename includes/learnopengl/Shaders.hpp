@@ -4,6 +4,7 @@
 #define SHADER_H
 
 #include "testgl/logging.hpp"
+#include "testgl/shadercache.hpp"
 #include <fstream>
 #include <glm/glm.hpp>
 #include <iostream>
@@ -16,7 +17,7 @@ class Shader
 {
 public:
     unsigned int ID;
-    Shader() {}
+    Shader() : pending(false) {}
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char *vertexPath, const char *fragmentPath,
@@ -65,49 +66,79 @@ public:
         {
             log_error("SHADER::FILE_NOT_SUCCESFULLY_READ");
         }
+        // Try the binary cache before compiling anything
+        ID = glCreateProgram();
+        cacheKey = shader_cache::makeKey(vertexCode, fragmentCode, geometryCode);
+        pending = false;
+        if (shader_cache::load(ID, cacheKey))
+            return;
+
         log_debug("Compiling shaders ... ");
         const char *vShaderCode = vertexCode.c_str();
         const char *fShaderCode = fragmentCode.c_str();
         // 2. compile shaders
-        unsigned int vertex, fragment;
+        // the status is only read in wait(), the driver may still be compiling
+        // when the constructor returns (GL_KHR_parallel_shader_compile)
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertex, 1, &vShaderCode, NULL);
         glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
         // fragment Shader
         fragment = glCreateShader(GL_FRAGMENT_SHADER);
         glShaderSource(fragment, 1, &fShaderCode, NULL);
         glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
         // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
+        geometry = 0;
         if (geometryPath != nullptr)
         {
             const char *gShaderCode = geometryCode.c_str();
             geometry = glCreateShader(GL_GEOMETRY_SHADER);
             glShaderSource(geometry, 1, &gShaderCode, NULL);
             glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
         }
         // shader Program
-        ID = glCreateProgram();
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
-        if (geometryPath != nullptr)
+        if (geometry != 0)
             glAttachShader(ID, geometry);
+        shader_cache::prepare(ID);
         glLinkProgram(ID);
+        pending = true;
+    }
+    // wait for the program to be linked, check it and store it in the cache
+    // done by use(), must be ran before querying the program
+    // ------------------------------------------------------------------------
+    void wait()
+    {
+        if (!pending)
+            return;
+        pending = false;
+        checkCompileErrors(vertex, "VERTEX");
+        checkCompileErrors(fragment, "FRAGMENT");
+        if (geometry != 0)
+            checkCompileErrors(geometry, "GEOMETRY");
         checkCompileErrors(ID, "PROGRAM");
         // delete the shaders as they're linked into our program now and no longer
         // necessery
+        glDetachShader(ID, vertex);
+        glDetachShader(ID, fragment);
         glDeleteShader(vertex);
         glDeleteShader(fragment);
-        if (geometryPath != nullptr)
+        if (geometry != 0)
+        {
+            glDetachShader(ID, geometry);
             glDeleteShader(geometry);
+        }
+        shader_cache::store(ID, cacheKey);
     }
     // activate the shader
     // ------------------------------------------------------------------------
-    void use() { glUseProgram(ID); }
+    void use()
+    {
+        if (pending)
+            wait();
+        glUseProgram(ID);
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
@@ -171,6 +202,11 @@ public:
     }
 
 private:
+    // sources still being compiled, see wait()
+    bool pending;
+    unsigned int vertex, fragment, geometry;
+    uint64_t cacheKey;
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "testgl/constants.hpp"
+#include "testgl/voxel.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#define BRICKS_PER_SIDE (CHUNK_SIZE / BRICK_SIZE)
+#define BRICK_COUNT (BRICKS_PER_SIDE * BRICKS_PER_SIDE * BRICKS_PER_SIDE)
+#define BRICK_VOXELS (BRICK_SIZE * BRICK_SIZE * BRICK_SIZE)
+
+// Table entries with this bit hold the voxel filling the whole brick instead of an index in the pool
+#define UNIFORM_BRICK 0x8000
+
+static_assert(CHUNK_SIZE % BRICK_SIZE == 0 && (BRICK_SIZE & (BRICK_SIZE - 1)) == 0, "BRICK_SIZE must be a power of two dividing CHUNK_SIZE");
+static_assert(BRICK_COUNT <= UNIFORM_BRICK, "Pool indices are stored on 15 bits");
+
+// Sparse byte per voxel of a chunk (the voxels, the light), split in BRICK_SIZE³ bricks
+// A brick filled with a single value only takes its table entry, the others are stored densely in a pool
+// The `classic` chunks are mostly air or dirt around a thin surface, so most of their bricks collapse
+// Coordinates are in voxels inside the chunk, like the dense arrays
+template <typename Cell>
+class BrickGrid
+{
+    static_assert(sizeof(Cell) == 1, "The uniform bricks hold their value in the low byte of the table entry");
+
+private:
+    // One entry per brick (x first, then y, then z): UNIFORM_BRICK | value, or the index of the brick in `pool`
+    std::vector<uint16_t> table;
+    // BRICK_VOXELS values per brick that is not uniform
+    std::vector<Cell> pool;
+    // Pool slots released by bricks that became uniform again
+    std::vector<uint16_t> freeSlots;
+
+    // Pool slot for a new brick filled with `value`
+    uint16_t allocate(Cell value);
+    // Release the pool slot of a brick if it holds a single value
+    void collapseBrick(uint16_t &entry);
+
+    static int localIndex(int x, int y, int z) { return (x & (BRICK_SIZE - 1)) + BRICK_SIZE * ((y & (BRICK_SIZE - 1)) + BRICK_SIZE * (z & (BRICK_SIZE - 1))); }
+
+public:
+    static int brickIndex(int x, int y, int z) { return x / BRICK_SIZE + BRICKS_PER_SIDE * (y / BRICK_SIZE + BRICKS_PER_SIDE * (z / BRICK_SIZE)); }
+    // Lowest voxel of a brick
+    static glm::ivec3 brickOrigin(int brick) { return glm::ivec3(brick % BRICKS_PER_SIDE, brick / BRICKS_PER_SIDE % BRICKS_PER_SIDE, brick / (BRICKS_PER_SIDE * BRICKS_PER_SIDE)) * BRICK_SIZE; }
+
+    // Whether anything is stored, the chunks that are simple or dense leave it empty
+    bool isUsed() { return !table.empty(); }
+
+    Cell get(int x, int y, int z)
+    {
+        uint16_t entry = table[brickIndex(x, y, z)];
+        if (entry & UNIFORM_BRICK)
+            return (Cell)(entry & 0xFF);
+        return pool[entry * BRICK_VOXELS + localIndex(x, y, z)];
+    }
+    // A brick that becomes uniform is collapsed again
+    void set(int x, int y, int z, Cell value);
+    // Same without collapsing, for the bulk edits that call collapse once they are done
+    void write(int x, int y, int z, Cell value);
+    // Collapse every brick that became uniform
+    void collapse();
+
+    // Whether a brick holds a single value, and which one
+    bool isUniform(int brick, Cell *value)
+    {
+        *value = (Cell)(table[brick] & 0xFF);
+        return table[brick] & UNIFORM_BRICK;
+    }
+
+    // Every brick uniform
+    void fill(Cell value);
+    // From and to a dense array (x + CHUNK_SIZE * (y + CHUNK_SIZE * z))
+    void compress(const Cell *values);
+    void expand(Cell *values);
+    void clear();
+
+    // Memory used by the table and the pool
+    size_t getBytes();
+};
+
+// The voxels of the chunks stored in bricks
+typedef BrickGrid<Voxel> BrickStorage;
+// Light of the chunks, see Chunk::getLight
+typedef BrickGrid<uint8_t> LightBricks;
@@ -5,63 +5,186 @@
 #include "learnopengl/Shaders.hpp"
 #include "testgl/cube.hpp"
 #include "testgl/worldgen.hpp"
-
+#include "testgl/chunkhandle.hpp"
+#include "testgl/bricks.hpp"
+#include "testgl/voxelregion.hpp"
+
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <mutex>
+#include <vector>
 #include <glm/glm.hpp>
 
 class World;
 
+// Mesh built by the tick thread, handed over to the main thread as a whole for the upload
+struct ChunkMesh
+{
+    // Face records for vertex pulling instead of the vertex arrays
+    bool pulled = false;
+    // in vertices
+    int size = 0;
+    std::vector<float> vertices, normals;
+    std::vector<int> colors;
+    // One record of three words per face, see packFace
+    std::vector<uint32_t> faces;
+    // Relative to the chunk origin
+    glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);
+    // One contiguous range of vertices per side (in side_to_index order)
+    int sideFirst[6] = {0}, sideCount[6] = {0};
+};
+
+// The two kinds of light stored for each voxel
+enum LightChannel : int
+{
+    SkyLight = 0, // Falls from the sky, straight down without losing any level
+    BlockLight = 1, // Emitted by voxels, see voxelEmission
+};
+
 class Chunk
 {
 private:
-    // If isSimpleChunk is true, then there is no guarantee that the voxels array is valid
-    Voxel voxels[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];
-    Sides needsDraw[CHUNK_SIZE][CHUNK_SIZE][CHUNK_SIZE];
+    // The voxels are either in `voxels` (dense) or in `bricks`, neither is allocated while isSimpleChunk is true
+    Voxel *voxels;
+    BrickStorage bricks;
+    // Write a voxel to whichever storage the chunk uses, the chunk must not be simple
+    void storeVoxel(int x, int y, int z, Voxel value);
+    // Allocate the storage chosen by brickStorage, filled with `voxel` or copied from a dense array
+    void allocateVoxels(Voxel voxel);
+    void allocateVoxels(const Voxel *source);
+    // Dense array of the voxels for the whole chunk passes, the bricks are expanded in a per thread buffer
+    // The chunk must not be simple
+    const Voxel *flatVoxels();
+
+    // Sky light on the high 4 bits and block light on the low 4 bits, always valid once calculateLight ran
+    // Stored in bricks, most of them are open sky or buried in the dark, or as a single level while `light` is unused
+    LightBricks light;
+    uint8_t uniformLight;
+    // Faces to draw of each voxel, only the bricks in `drawnBricks` are stored
+    BrickGrid<Sides> needsDraw;
     int needsDrawCount;
+    // Bricks (BrickStorage::brickIndex) holding at least one voxel to draw, the mesher only visits those
+    std::bitset<BRICK_COUNT> drawnBricks;
+
+    // Which pairs of faces can see each other through air inside the chunk, one bit per side_pair_index
+    uint16_t connectivity;
+    void calculateConnectivity();
 
     // If the chunk contains only one type of voxel, we can simplify a lot of things
     bool isSimpleChunk;
     Voxel simpleChunkVoxel;
 
-    float *meshVertices;
-    float *meshNormals; // unused
-    int *meshColors;
+    // Whether a voxel is solid, the coordinates can be one voxel outside the chunk
+    bool isOpaqueAt(int x, int y, int z);
+    // Light level of a voxel, the coordinates can be one voxel outside the chunk
+    // Returns -1 if that voxel is not loaded
+    int lightAt(int x, int y, int z, LightChannel channel);
+    // Ambient occlusion of the 4 corners of a face (in CubeMeshSides::corners order), from 0 (darkest) to 3 (open)
+    // and their smooth sky and block light, the average of the open voxels around the corner
+    void faceShading(int x, int y, int z, int side, int occlusion[4], int skyLight[4], int blockLight[4]);
+
+    // The tick thread puts each finished mesh in `readyMesh`, replacing one the main thread did not take yet
+    // The main thread takes it and owns it as `uploadingMesh` until it is uploaded, both are swapped under meshMutex
+    std::mutex meshMutex;
+    ChunkMesh *readyMesh;
+    ChunkMesh *uploadingMesh;
+
+    // Whether the uploaded mesh is face records for vertex pulling
+    bool drawPulled;
     std::vector<unsigned int> meshIndices;
-    int meshSize;
 
     unsigned int VAO, VBO, EBO;
+    // GL_R32UI texture buffer over VBO, read by pulled.vert
+    unsigned int faceTexture;
+    // Number of vertices in VBO, which is what gets drawn
+    int drawSize;
+
+    // A mesh can be uploaded over several frames in a separate buffer
+    // VBO keeps being drawn until the upload is complete
+    unsigned int uploadVBO;
+    size_t uploadOffset;
+
+    // Bounding box and side ranges of the uploaded mesh, see ChunkMesh
+    glm::vec3 drawBoundsMin, drawBoundsMax;
+    int drawSideFirst[6], drawSideCount[6];
+
+    // GL_ANY_SAMPLES_PASSED queries of the bounding box, see OcclusionCuller
+    // Two so that the query of the previous frame is still readable while the next one is issued
+    unsigned int occlusionQueries[2];
+    // OcclusionCuller frame each query was last issued in, -1 if never
+    int occlusionQueryFrames[2];
 
     int m_x, m_y, m_z;
 
     glm::mat4 m_modelMatrix;
     glm::mat4 m_invModelMatrix;
 
-    bool hasBuffer, needsSideOcclusionUpdate, needsMeshUpdate, needsMeshUpload;
+    bool hasBuffer, needsSideOcclusionUpdate, needsMeshUpdate;
+    // Set with a new readyMesh, cleared once no mesh is left to upload
+    std::atomic<bool> needsMeshUpload;
     Sides edgeChanged;
 
     bool scheduledForDeletion;
     World *world;
 
+    // Handle used by the world queues to reference this chunk
+    ChunkHandle handle;
+
 public:
+    // Generate face records read by pulled.vert instead of vertices (toggled with F9)
+    // Only applies to the meshes generated afterwards
+    static std::atomic<bool> vertexPulling;
+
+    // Store the voxels of the chunks populated afterwards in bricks instead of dense arrays
+    // Set before the world is created (BRICK_STORAGE, --dense)
+    static bool brickStorage;
+
     Chunk() = default;
     // Coordinates of the chunk in the world (in chunks)
     Chunk(int x, int y, int z, World *world);
     ~Chunk();
 
     bool isEmpty() { return isSimpleChunk && simpleChunkVoxel == Voxel::Air; }
+    bool isSimple() { return isSimpleChunk; }
+    // Memory used by the voxels, 0 for a simple chunk
+    size_t getVoxelBytes() { return (voxels ? CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE * sizeof(Voxel) : 0) + bricks.getBytes(); }
 
     Voxel getVoxel(int x, int y, int z);
+    // Side of the aligned cube of air around a voxel that a ray crosses in one step: CHUNK_SIZE in an empty chunk,
+    // BRICK_SIZE in a brick of air, 1 for any other air voxel and 0 if the voxel is not air
+    int getAirCell(int x, int y, int z);
     void setVoxel(int x, int y, int z, Voxel value);
     void setVoxelLayer(int y, Voxel value);
+    // Write the part of `region` inside the chunk, `origin` is the lower corner of the region relative to the chunk
+    // Every written voxel is `*fill` when it is not nullptr, otherwise the voxels of the region
+    // The replaced voxels are appended to `changes` and the chunk is queued once for its side occlusion or its mesh
+    void writeRegion(const VoxelRegion &region, glm::ivec3 origin, const Voxel *fill, std::vector<VoxelChange> &changes);
 
     void populate(WorldGenerator::function_t worldGenerator);
 
+    // Flood the sky light (assuming the sky is open above the chunk) and the light of the emitters inside the chunk
+    // Only touches this chunk so it can run on any thread, LightEngine::connect then spreads it across the borders
+    void calculateLight();
+    int getLight(int x, int y, int z, LightChannel channel);
+    void setLight(int x, int y, int z, LightChannel channel, int level);
+    // Memory used by the light, 0 while the whole chunk has a single level
+    size_t getLightBytes() { return light.getBytes(); }
+    // Memory of the chunk on the CPU: the object itself with its fixed arrays, the voxels, the light and the faces to draw
+    size_t getBytes() { return sizeof(Chunk) + getVoxelBytes() + getLightBytes() + needsDraw.getBytes(); }
+
     // For proper culling with neighboring chunks
     void getObstructions(Side side, bool(obstructions)[CHUNK_SIZE][CHUNK_SIZE]);
 
     void calculateNeedsDraw();
     void generateMesh();
-    void uploadMesh();
-    void draw(Shader *shader);
+    // Upload up to `maxBytes` of the mesh to the GPU, returns the number of bytes uploaded
+    // Must be called again while getNeedsMeshUpload is true
+    size_t uploadMesh(size_t maxBytes);
+    // Only the sides that can face the camera are drawn
+    void draw(Shader *shader, glm::vec3 cameraPosition);
+    // Draw calls issued by every chunk (all the passes) since the counter was last reset, main thread only
+    static int drawCalls;
     void discard();
 
     glm::mat4 getModelMatrix() { return m_modelMatrix; }
@@ -70,14 +193,34 @@ public:
     int getY() { return m_y; }
     int getZ() { return m_z; }
     ChunkPos getPos() { return ChunkPos(m_x, m_y, m_z); }
+    ChunkHandle getHandle() { return handle; }
+    void setHandle(ChunkHandle value) { handle = value; }
+
+    // Whether a ray entering through `from` can leave through `to`
+    bool canSeeThrough(int from, int to) { return from == to || (connectivity >> side_pair_index(from, to)) & 1; }
+
+    // Whether draw() would draw anything
+    bool isDrawable() { return drawSize > 0 && hasBuffer && !scheduledForDeletion; }
+    int getDrawSize() { return drawSize; }
+    // Whether the uploaded mesh must be drawn with pulled.vert
+    bool isPulled() { return drawPulled; }
+    // GPU memory used by the uploaded mesh
+    size_t getDrawBytes();
+    glm::vec3 getDrawBoundsMin() { return drawBoundsMin; }
+    glm::vec3 getDrawBoundsMax() { return drawBoundsMax; }
+    // Created on first use, deleted by discard()
+    unsigned int getOcclusionQuery(int slot);
+    int getOcclusionQueryFrame(int slot) { return occlusionQueryFrames[slot]; }
+    void setOcclusionQueryFrame(int slot, int frame) { occlusionQueryFrames[slot] = frame; }
 
     bool getNeedsSideOcclusionUpdate() { return needsSideOcclusionUpdate; }
     bool getNeedsMeshUpdate() { return needsMeshUpdate; }
-    bool getNeedsMeshUpload() { return needsMeshUpload && meshSize; }
+    bool getNeedsMeshUpload() { return needsMeshUpload; }
     bool getScheduleForDeletion() { return scheduledForDeletion; }
     Sides getEdgeChanged() { return edgeChanged; }
     void setEdgeChanged(Sides sides) { edgeChanged = sides; }
     void setNeedsSideOcclusionUpdate(bool value) { needsSideOcclusionUpdate = value; }
+    void setNeedsMeshUpdate(bool value) { needsMeshUpdate = value; }
 
     void print_info();
 
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class Chunk;
+
+// Weak reference to a chunk: a slot in the handle table and the generation of that slot
+// Once the chunk is released, the slot generation changes and the handle becomes stale
+struct ChunkHandle
+{
+    uint32_t index;
+    uint32_t generation;
+};
+
+class ChunkHandleTable
+{
+private:
+    struct Slot
+    {
+        Chunk *chunk;
+        uint32_t generation;
+    };
+
+    std::vector<Slot> slots;
+    // Indices of the released slots, reused before growing `slots`
+    std::vector<uint32_t> freeSlots;
+
+public:
+    ChunkHandleTable() = default;
+
+    // Register a chunk and return a handle to it
+    ChunkHandle insert(Chunk *chunk);
+
+    // Invalidate every handle pointing to this slot
+    // Does not delete the chunk
+    void release(ChunkHandle handle);
+
+    // Get the chunk behind a handle, or nullptr if the handle is stale
+    Chunk *get(ChunkHandle handle) const
+    {
+        if (handle.index >= slots.size())
+            return nullptr;
+        const Slot &slot = slots[handle.index];
+        return slot.generation == handle.generation ? slot.chunk : nullptr;
+    }
+
+    // Number of live handles
+    int size() const { return slots.size() - freeSlots.size(); }
+};
@@ -4,22 +4,105 @@
 #define WINDOW_HEIGHT 600
 #define WINDOW_WIDTH 800
 
-#define GLFW_VSYNC 1 // 0 = off, 1 = on
+#define PACING_MODE 0                 // 0 = vsync, 1 = capped at PACING_TARGET_FPS, 2 = uncapped, can be cycled with F2
+#define PACING_TARGET_FPS 120         // in frames per second, for the capped mode
+#define PACING_MAX_FRAMES_IN_FLIGHT 2 // frames queued on the GPU before the next one waits, more adds input latency
 #define CAPTURE_MOUSE false
 
 #ifndef NDEBUG
 #define GLFW_REQUEST_DEBUG_CONTEXT true
 #endif
 
-#define CHUNK_SIZE 64           // in voxels
-#define VIEW_DISTANCE 4         // in chunks
+#ifndef CHUNK_SIZE
+#define CHUNK_SIZE 64 // in voxels, up to 64, the build can set it (see CHUNK_SIZE_VARIANTS in CMakeLists.txt)
+#endif
+#define VIEW_DISTANCE (256 / CHUNK_SIZE) // in chunks, the same 256 voxels whatever the chunk size
 #define HEIGHT_VIEW_REDUCTION 3 // 1 = no reduction, 2 = half, 3 = third, etc.
+#define BRICK_STORAGE true      // store the voxels of the chunks in bricks, --dense on the command line stores them in flat arrays
+#define BRICK_SIZE 4            // in voxels, a power of two dividing CHUNK_SIZE
+#define PICK_REACH 8.0f         // in voxels, how far the mouse breaks and places voxels
 
 #define GEN_ALL_CHUNKS_ON_START false
 
+#define MATERIAL_COUNT 256  // one per Voxel value, must match NUM_MATERIALS in base.frag
+#define MATERIALS_BINDING 0 // uniform buffer binding point of the material table
+#define FRAME_UNIFORMS_BINDING 1 // uniform buffer binding point of the per-frame camera, time and light data
+
 #define TICKS_PER_SECOND 20
-#define CHUNK_GEN_PER_TICK 4
-#define CHUNK_MESH_PER_TICK 4
-#define CHUNK_GPU_UPLOAD_PER_FRAME 8
+#define TICK_BUDGET 0.8f               // fraction of the tick period given to chunk work
+#define MAX_TICK_CATCH_UP 5            // in ticks, older late ticks are skipped
+#define TICK_STAGE_INITIAL_COST 0.002f // in seconds per chunk, refined while running
+#define MAX_CHUNKS_PER_STAGE (64 * 64 * 64 * 64 / (CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE)) // per tick, as many voxels as 64 chunks of 64³
+
+#define UPLOAD_TARGET_FRAME_TIME (1.0f / 60.0f)          // in seconds
+#define UPLOAD_FRAME_FRACTION 0.25f                      // share of the target frame time given to mesh uploads
+#define UPLOAD_MIN_BYTES_PER_FRAME (64 * 1024)           // always upload at least this much
+#define UPLOAD_MAX_BYTES_PER_FRAME (16 * 1024 * 1024)    // even when the GPU is idle
+#define UPLOAD_INITIAL_THROUGHPUT (256.0f * 1024 * 1024) // in bytes per second, refined while running
+#define UPLOAD_SPIKE_FACTOR 1.5f                         // frames longer than this times the target are spikes
+
+#define OCCLUSION_CULLING true // can be toggled with F6
+#define VISIBILITY_CULLING true // can be toggled with F7
+#define DEPTH_PREPASS false // can be toggled with F8
+#define VERTEX_PULLING false // can be toggled with F9, every chunk is meshed again
+#define DEFERRED_SHADING false // can be toggled with F10
+#define SHADOWS true // can be toggled with F11
+#define DYNAMIC_RESOLUTION true // can be toggled with F12
+
+#define MAX_POINT_LIGHTS 128       // must match MAX_POINT_LIGHTS in lighting.frag
+#define POINT_LIGHTS_BINDING 2     // uniform buffer binding point of the deferred point lights
+#define DEFERRED_TEST_LIGHTS 32    // point lights placed around the spawn to measure the lighting pass
+
+#define SHADOW_CASCADES 3                         // at most 4, must match SHADOW_CASCADES in base.frag and lighting.frag
+#define SHADOW_CASCADE_SPLITS {24.0f, 96.0f, 384.0f} // in voxels from the camera, where each cascade ends
+#define SHADOW_MAP_SIZE 2048                      // in texels, per cascade
+#define SHADOW_CACHE_MARGIN 0.25f                 // the cached cascades cover this much more so that the camera can move
+#define SHADOW_ANGLE_THRESHOLD 0.5f               // in degrees, sun rotation before the cached cascades are rendered again
+#define SHADOW_MAX_CACHED_UPDATES 1               // cached cascades rendered per frame, the first cascade is always rendered
+#define SHADOW_CASTER_DISTANCE 128.0f             // in voxels, how far towards the sun the casters are looked for
+#define SHADOW_SLOPE_BIAS 2.0f                    // glPolygonOffset factor when rendering the maps
+#define SHADOWS_BINDING 3                         // uniform buffer binding point of the cascade matrices
+#define SHADOW_MAP_UNIT 3                         // texture unit of the shadow maps
+
+#define RESOLUTION_TARGET_FRAME_TIME (1.0f / 60.0f) // in seconds of GPU time
+#define RESOLUTION_MIN_SCALE 0.5f                   // fraction of the window size
+#define RESOLUTION_MAX_SCALE 1.0f                   // at least 1, above 1 supersamples
+#define RESOLUTION_TOLERANCE 0.1f                   // the scale only changes when the frame time is this far from the target
+#define RESOLUTION_ADJUST_RATE 0.1f                 // how fast the scale moves towards the wanted one, per frame
+#define RESOLUTION_GPU_LATENCY 3                    // in frames, how long the timestamp queries are kept before reading them
+
+#define SHADER_CACHE true                // linked programs are kept on disk between runs
+#define SHADER_CACHE_DIR "shader_cache" // Relative to the build directory
+
+#define HEADLESS_FRAMES 600                // frames rendered by --headless, can be changed with --frames=N
+#define HEADLESS_WIDTH 1280                // in pixels
+#define HEADLESS_HEIGHT 720                // in pixels
+#define HEADLESS_FRAME_TIME (1.0f / 60.0f) // in seconds, simulated time between two frames
+#define HEADLESS_PATH_RADIUS 96.0f         // in voxels, the camera circles around the spawn
+#define HEADLESS_PATH_HEIGHT 80.0f         // in voxels
+#define HEADLESS_PATH_PITCH -20.0f         // in degrees
+#define HEADLESS_OUTPUT_PATH "benchmark.csv" // Relative to the build directory, can be changed with --output=PATH
+#define HEADLESS_WARMUP_FRAMES 10          // left out of the frame times
+#define HEADLESS_EDIT_INTERVAL 30          // in frames, a voxel under the camera is dug to measure the edit latency
+#define HEADLESS_SPHERE_RADIUS 12          // in voxels, dug at the end of the run to compare the bulk and the single voxel edits
+#define HEADLESS_RAYS 100000               // cast in every direction from the camera at the end of the run
+#define HEADLESS_RAY_REACH 256.0f          // in voxels, the view distance
+
+#define FAR_TERRAIN true        // can be toggled with F1
+#define CLIPMAP_LEVELS 8        // rings of the far terrain, each one twice as coarse and twice as large, must match farterrain.vert
+#define CLIPMAP_SIZE 128        // in texels per side of each level, must be a power of two, must match farterrain.vert
+#define CLIPMAP_SPACING 8       // in voxels between two samples of the finest level
+#define CLIPMAP_MORPH_BAND 0.2f // fraction of each level, at its border, blended towards the next coarser one
+#define CLIPMAP_OVERLAP 32.0f   // in voxels, how far the far terrain reaches under the chunks
+#define CLIPMAP_NEAR_PLANE 1.0f // in voxels, the far terrain has its own depth range
+
+#define MAX_LIGHT_LEVEL 15 // sky and block light are stored on 4 bits each
+#define LIGHT_THREADS 4     // threads flooding the light of the chunks loaded in the same tick, the tick thread included
 
 #define DAY_LENGTH 300 // in seconds
+
+#define PROFILER_ENABLED 1                // 0 = compiled out, 1 = toggled at runtime with F4
+#define PROFILER_HISTORY 120              // in frames, shown by the overlay
+#define PROFILER_GPU_LATENCY 3            // in frames, before reading back GPU timer queries
+#define PROFILER_MAX_TRACE_EVENTS 1000000 // the capture stops when the buffer is full
+#define TRACE_OUTPUT_PATH "trace.json"    // Relative to the build directory
@@ -89,6 +89,20 @@ namespace CubeMeshSides
         {0.0f, -1.0f, 0.0f}  // bottom
     };
 
+    // Corners of each side, counter-clockwise seen from outside, as offsets from the voxel center in half voxels
+    const int corners[6][4][3] = {
+        {{-1, -1, 1}, {1, -1, 1}, {1, 1, 1}, {-1, 1, 1}},     // front
+        {{1, -1, -1}, {-1, -1, -1}, {-1, 1, -1}, {1, 1, -1}}, // back
+        {{-1, -1, -1}, {-1, -1, 1}, {-1, 1, 1}, {-1, 1, -1}}, // left
+        {{1, -1, 1}, {1, -1, -1}, {1, 1, -1}, {1, 1, 1}},     // right
+        {{-1, 1, 1}, {1, 1, 1}, {1, 1, -1}, {-1, 1, -1}},     // top
+        {{-1, -1, -1}, {1, -1, -1}, {1, -1, 1}, {-1, -1, 1}}  // bottom
+    };
+    // The two triangles of a face, split along corners 0-2 or, when flipped, along corners 1-3
+    const int quad_triangles[2][6] = {
+        {0, 1, 2, 2, 3, 0},
+        {1, 2, 3, 3, 0, 1}};
+
     float *faces_at(float x, float y, float z, Sides sides, float destination[]);
     float *faces_at(glm::vec3 pos, Sides sides, float destination[]);
     float *normals_on(Sides sides, float destination[3 * 6]);
@@ -96,4 +110,7 @@ namespace CubeMeshSides
 
 Side opposite_side(Side side);
 int side_to_index(Side side);
-ChunkPos dirFromSide(Side side);
\ No newline at end of file
+ChunkPos dirFromSide(Side side);
+
+// Index of an unordered pair of side indices (0 to 5) among the 15 possible pairs
+int side_pair_index(int a, int b);
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "learnopengl/Shaders.hpp"
+#include "testgl/constants.hpp"
+
+#include <glm/glm.hpp>
+
+// Deferred shading: the chunks only write their normal, material index, baked shading and depth to a G-buffer,
+// then a full-screen pass lights every pixel once, with the sun and up to MAX_POINT_LIGHTS point lights
+// The lighting cost depends on the number of pixels instead of the number of rasterized fragments
+class DeferredRenderer
+{
+private:
+    // std140 layout of the `Lights` uniform block
+    struct GPUPointLight
+    {
+        glm::vec4 positionRadius; // xyz position, w radius
+        glm::vec4 color;
+    };
+    struct GPULights
+    {
+        int count;
+        int padding[3];
+        GPUPointLight lights[MAX_POINT_LIGHTS];
+    };
+
+    unsigned int FBO;
+    unsigned int normalTexture, materialTexture, depthTexture;
+    // Allocated size, and the part of it used by the current frame
+    int width, height;
+    int renderWidth, renderHeight;
+
+    // Geometry pass, for the expanded and pulled meshes
+    Shader geometryShader;
+    Shader pulledGeometryShader;
+
+    // Full-screen lighting pass
+    Shader lightingShader;
+    unsigned int VAO;
+
+    GPULights lights;
+    unsigned int lightsUBO;
+    bool lightsChanged;
+
+    void createTargets();
+    void deleteTargets();
+
+public:
+    // Toggled with F10
+    static bool enabled;
+
+    DeferredRenderer(int width, int height);
+    ~DeferredRenderer();
+
+    // Recreate the G-buffer at another size, the largest the frames can be
+    void resize(int width, int height);
+
+    Shader *getGeometryShader() { return &geometryShader; }
+    Shader *getPulledGeometryShader() { return &pulledGeometryShader; }
+    // The lighting pass needs the light colors, see Sun::setupShader
+    Shader *getLightingShader() { return &lightingShader; }
+
+    // Point lights, uploaded before the next lighting pass
+    // Returns false when MAX_POINT_LIGHTS is reached
+    bool addLight(glm::vec3 position, float radius, glm::vec3 color);
+    void clearLights();
+    int getLightCount() { return lights.count; }
+
+    // Bind and clear the G-buffer, the chunks must then be drawn with the geometry shaders
+    // The frame can be smaller than the G-buffer, see DynamicResolution
+    void beginGeometry(int renderWidth, int renderHeight);
+    // Light the G-buffer into `framebuffer`
+    void shade(const glm::mat4 &view, const glm::mat4 &projection, unsigned int framebuffer);
+};
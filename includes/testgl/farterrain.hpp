@@ -0,0 +1,56 @@
+#pragma once
+
+#include "learnopengl/Shaders.hpp"
+#include "testgl/constants.hpp"
+
+#include <glm/glm.hpp>
+
+// Geometry clipmap of the `classic` heightmap, drawn past the loaded chunks out to the horizon
+// Each level is the same grid around the camera, twice as coarse and twice as large as the previous one,
+// so the cost does not depend on how far it reaches. The heights live in a texture array (one layer per level)
+// addressed toroidally: when the camera moves, only the rows and columns that entered a level are computed
+// Near its border, each level blends towards the next coarser one so that the rings meet without cracks,
+// and the finest level reaches CLIPMAP_OVERLAP voxels under the chunks, which are drawn over it
+class FarTerrain
+{
+private:
+    Shader shader;
+    unsigned int VAO, VBO, EBO;
+    int indexCount;
+
+    // GL_RG32F texture array: height of the surface and voxel of each sample
+    unsigned int heightTexture;
+
+    // Lower corner of each level, in samples of that level, as stored in the texture
+    glm::ivec2 origins[CLIPMAP_LEVELS];
+    bool valid[CLIPMAP_LEVELS];
+
+    // Samples computed since the last resetStats
+    int updatedSamples;
+
+    float getSpacing(int level) { return (float)(CLIPMAP_SPACING << level); }
+
+    // Compute and upload `count` columns (along x) or rows (along z) of a level, starting at sample `first`
+    // The other axis covers the level at `origin`
+    void updateColumns(int level, glm::ivec2 origin, int first, int count);
+    void updateRows(int level, glm::ivec2 origin, int first, int count);
+
+public:
+    // Toggled with F1
+    static bool enabled;
+
+    FarTerrain();
+    ~FarTerrain();
+
+    // Follow the camera, only the samples that entered a level are computed
+    void update(glm::vec3 cameraPosition);
+
+    // Draw the levels with their own depth range, before the chunks
+    // The caller must clear the depth before drawing the chunks in the same framebuffer
+    void draw(const glm::mat4 &projection, glm::vec3 cameraPosition);
+
+    Shader *getShader() { return &shader; }
+
+    int getUpdatedSamples() { return updatedSamples; }
+    void resetStats() { updatedSamples = 0; }
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "learnopengl/Shaders.hpp"
+
+#include <glm/glm.hpp>
+
+// Camera, time and light data shared by every program through the `Frame` uniform block
+// The block is written once per frame, instead of setting the same uniforms on each program
+class FrameUniforms
+{
+private:
+    // std140 layout of the `Frame` block
+    struct Data
+    {
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::vec3 viewPos;
+        float time;
+        glm::vec3 lightPosition;
+        float padding;
+    };
+    static_assert(sizeof(Data) == 160, "FrameUniforms::Data must match the std140 layout");
+
+    Data data;
+    unsigned int UBO;
+
+public:
+    FrameUniforms();
+    ~FrameUniforms();
+
+    // Attach the `Frame` uniform block of a shader to the shared binding point
+    static void attach(Shader *shader);
+
+    void setCamera(const glm::mat4 &view, const glm::mat4 &projection, glm::vec3 viewPos);
+    void setTime(float time) { data.time = time; }
+    void setLightPosition(glm::vec3 position) { data.lightPosition = position; }
+
+    // Write the block, once per frame before drawing
+    void upload();
+
+    // Make this block the one read by the programs, done by the constructor
+    // Several instances can be used to draw from other points of view (see ShadowCascades)
+    void bind();
+};
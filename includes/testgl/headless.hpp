@@ -0,0 +1,81 @@
+#pragma once
+
+#include "testgl/player.hpp"
+#include "testgl/world.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Off-screen benchmark runs: no display, a scripted camera and a world that is fully built every frame
+// so that two runs of the same build render the same images
+namespace headless
+{
+    struct Options
+    {
+        bool enabled;
+        int frames;
+        bool hash; // Print a hash of the last frame
+        bool dense; // Store the voxels in flat arrays instead of bricks, to compare both (also outside headless runs)
+        const char *output; // Frame times CSV
+    };
+
+    // --headless, --frames=N, --hash, --dense and --output=PATH
+    Options parseArguments(int argc, char **argv);
+
+    // Place the camera where it is at `frame` along the scripted path
+    void followPath(Player *player, int frame);
+
+    // Wall time of every frame, summarized once the run is over
+    class FrameTimes
+    {
+    private:
+        std::vector<float> times; // in milliseconds
+
+    public:
+        void add(float time) { times.push_back(time); }
+
+        // Log the statistics and write every frame time to `path` as CSV
+        void report(const char *path);
+    };
+
+    // Dig the highest voxel under `position` and build everything it changed
+    // Returns the time until the new meshes are uploaded, in milliseconds
+    float editTerrain(World *world, glm::vec3 position);
+
+    // Chunk work of the run, to compare the executables built with other chunk sizes
+    class ChunkStats
+    {
+    private:
+        std::vector<float> editLatencies; // in milliseconds
+        std::vector<float> settleTimes;   // in milliseconds, building the world before each frame
+        float buildTime;                  // in milliseconds, the world built before the first frame
+        long drawCalls;
+        int frames;
+
+    public:
+        ChunkStats() : buildTime(0.0f), drawCalls(0), frames(0) {}
+        void addFrame(int frameDrawCalls)
+        {
+            drawCalls += frameDrawCalls;
+            frames++;
+        }
+        void addEdit(float latency) { editLatencies.push_back(latency); }
+        void addSettle(float time) { settleTimes.push_back(time); }
+        void setBuildTime(float time) { buildTime = time; }
+
+        // Log the generation and meshing times of the world, the time spent building it and the statistics of the run
+        void report(World *world);
+    };
+
+    // Dig a sphere of HEADLESS_SPHERE_RADIUS voxels in the ground under `position` with World::fillSphere, then the same
+    // sphere with one World::setVoxel per voxel, and log the time until the meshes are uploaded and the chunks meshed
+    // The terrain is pasted back after each of them
+    void benchmarkBulkEdit(World *world, glm::vec3 position);
+
+    // Cast HEADLESS_RAYS rays of HEADLESS_RAY_REACH voxels spread over every direction from `position`, log the rays per second
+    void benchmarkRaycast(World *world, glm::vec3 position);
+
+    // FNV-1a of the pixels of the first color attachment of `framebuffer`
+    // Returns false, without a hash, if the pixels could not be read
+    bool hashFramebuffer(unsigned int framebuffer, int width, int height, uint64_t *hash);
+} // namespace headless
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "testgl/chunk.hpp"
+#include "testgl/chunkpos.hpp"
+#include "testgl/constants.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// Sky and block light propagation across the loaded chunks
+// Each chunk floods its own light when it is created (Chunk::calculateLight), the engine then spreads it
+// across the chunk borders and updates it incrementally when a voxel changes
+// Must be ran from the thread that owns the chunks (the tick thread)
+class LightEngine
+{
+private:
+    std::map<ChunkPos, Chunk *> &chunks;
+
+    // World coordinates of a voxel and, for removals, the level it had
+    struct Node
+    {
+        int x, y, z;
+        int level;
+    };
+    // One queue of each kind per LightChannel
+    std::queue<Node> addQueues[2];
+    std::queue<Node> removeQueues[2];
+
+    // Chunks whose mesh sampled a light that changed
+    std::unordered_set<ChunkPos, ChunkPosTools::ChunkPosHash> changedChunks;
+
+    // Consecutive lookups mostly hit the same chunk, reset by every public call
+    ChunkPos cachedPos;
+    Chunk *cachedChunk;
+
+    // Chunk holding a voxel and the coordinates of the voxel inside it, nullptr if not loaded
+    Chunk *chunkAt(int x, int y, int z, int &localX, int &localY, int &localZ);
+
+    // -1 if the voxel is not loaded
+    int getLight(int x, int y, int z, LightChannel channel);
+    void setLight(int x, int y, int z, LightChannel channel, int level);
+    // Voxels outside the loaded chunks are opaque so that the light stops there
+    bool isOpaque(int x, int y, int z);
+
+    void queueAdd(int x, int y, int z, LightChannel channel);
+    void queueRemove(int x, int y, int z, LightChannel channel);
+
+    // Run the removals first, they queue the voxels that must light the emptied area again
+    void propagate();
+    void unspread(LightChannel channel);
+    void spread(LightChannel channel);
+
+    // Queue the light updates around a voxel that changed from `before`, propagate runs them
+    void queueChange(int x, int y, int z, Voxel before);
+
+    // The sky light assumed on top of `lower` is not there if `upper` does not let it through
+    void reconcileSky(Chunk *lower, Chunk *upper);
+
+public:
+    LightEngine(std::map<ChunkPos, Chunk *> &chunks);
+
+    // Exchange the light between a chunk fresh from Chunk::calculateLight and its loaded neighbors
+    void connect(Chunk *chunk);
+
+    // Update the light around a voxel, after it changed from `before`
+    void voxelChanged(int x, int y, int z, Voxel before);
+    // Same for many voxels in a single propagation, for the bulk edits
+    void voxelsChanged(const std::vector<VoxelChange> &changes);
+
+    // Chunks that must be meshed again since the last call
+    void takeChangedChunks(std::vector<ChunkPos> &changed);
+};
+
+// LIGHT_THREADS - 1 threads started once, that run Chunk::calculateLight on the chunks loaded in the same tick
+// They live as long as the world so that their thread_local scratch buffers are allocated once
+class LightWorkers
+{
+private:
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    // Chunks being lit, nullptr between two batches
+    const std::vector<Chunk *> *batch;
+    uint64_t generation; // Incremented for each batch, so that a worker takes part in it only once
+    std::atomic<size_t> next;
+    int busyWorkers;
+    bool stopping;
+
+    void run();
+    // Light the chunks of the batch until none is left
+    void work();
+
+public:
+    LightWorkers();
+    ~LightWorkers();
+
+    // Calculate the light of every chunk of `chunks`, with the calling thread helping, returns once they are all done
+    void light(const std::vector<Chunk *> &chunks);
+};
@@ -44,4 +44,8 @@ namespace logging_utils
     void error(const char *file, int line, const char *fmt, ...);
     void fatal(const char *file, int line, const char *fmt, ...);
     void debug(const char *file, int line, const char *fmt, ...);
+
+    // Messages are queued and written by a background thread, so that logging never blocks the caller
+    // Write everything that is still queued, from the calling thread
+    void flush();
 } // namespace log
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "learnopengl/Shaders.hpp"
+
+#include <glm/glm.hpp>
+
+class Chunk;
+
+// Hardware occlusion culling with conditional rendering
+// Before a chunk is drawn, its bounding box is rasterized against the depth buffer inside a
+// GL_ANY_SAMPLES_PASSED query. The chunk is drawn if the box was visible in the query of the previous frame,
+// which the GPU has usually finished, so that it never waits for a query it has just been given (GL_QUERY_NO_WAIT
+// draws the chunk if the result is still not there). A chunk coming out from behind terrain appears one frame late.
+// The decision is taken on the GPU, there is no readback in the draw path.
+class OcclusionCuller
+{
+private:
+    Shader shader;
+    unsigned int VAO, VBO;
+
+    // Statistics of the previous frame, read from the queries once they are available
+    int occludedChunks, occludedVertices;
+    int testedChunks;
+
+    // Counted by beginFrame, selects the query slot of the chunks
+    int frame;
+
+public:
+    // Toggled with F6
+    static bool enabled;
+
+    OcclusionCuller();
+    ~OcclusionCuller();
+
+    // Must be called once per frame before drawing
+    void beginFrame();
+
+    // Draw the chunk if its bounding box is not hidden by what has already been drawn
+    void draw(Chunk *chunk, Shader *chunkShader, glm::vec3 cameraPosition);
+
+    // Counts of the previous frame, known one frame late
+    int getOccludedChunks() { return occludedChunks; }
+    int getOccludedVertices() { return occludedVertices; }
+    int getTestedChunks() { return testedChunks; }
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "learnopengl/Shaders.hpp"
+#include "testgl/profiler.hpp"
+
+#include <vector>
+
+// Rolling frame time graph drawn on top of the scene
+// Each frame gets three stacked columns: main thread CPU, GPU and tick thread CPU
+class Overlay
+{
+private:
+    Shader shader;
+    unsigned int VAO, VBO;
+    std::vector<float> vertices;
+
+    // Append a rectangle in normalized device coordinates
+    void addRect(float x0, float y0, float x1, float y1, const float color[3]);
+
+public:
+    Overlay();
+    ~Overlay();
+
+    // Only draws while the profiler is enabled
+    // Must be ran from the main thread, after the scene
+    void draw();
+};
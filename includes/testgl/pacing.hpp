@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <glad/glad.h>
+
+#include "testgl/constants.hpp"
+
+// Decides when a frame starts and measures how old the input is once the frame is done
+// The input is read right after beginFrame, so waiting here instead of in glfwSwapBuffers keeps it fresh
+class FramePacer
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    enum Mode : int
+    {
+        VSync = 0, // glfwSwapBuffers waits for the display
+        Capped,    // no vsync, sleep until the next PACING_TARGET_FPS deadline
+        Uncapped,  // no vsync, no wait
+        MODE_COUNT
+    };
+
+    // Cycled with F2, applied at the next frame
+    static Mode mode;
+    static const char *modeNames[MODE_COUNT];
+    static void cycleMode();
+
+private:
+    // Frames the GPU is still working on, with the time their input was read
+    struct InFlight
+    {
+        GLsync fence;
+        GLuint endQuery; // GL_TIMESTAMP written by the GPU once the frame is done
+        clock::time_point inputTime;
+        // The GPU clock and the CPU clock read together at the end of the frame, to convert the end timestamp
+        GLint64 gpuTime;
+        clock::time_point cpuTime;
+    };
+    InFlight frames[PACING_MAX_FRAMES_IN_FLIGHT];
+    int frame;
+
+    Mode appliedMode;
+    clock::time_point deadline;
+    clock::time_point frameStart;
+    clock::time_point inputTime;
+
+    // Since the start, per mode
+    struct Stats
+    {
+        int frames;
+        double interval, intervalSquared; // in seconds, between two frame starts
+        int latencies;
+        double latency, maxLatency; // in seconds, from the input to the end of the frame on the GPU
+    };
+    Stats stats[MODE_COUNT];
+
+    void applyMode();
+    // Record the latency of a finished frame, from its input to the time the GPU finished it
+    // Returns false if it is still running after `timeout` nanoseconds
+    bool retire(InFlight &inFlight, GLuint64 timeout);
+
+public:
+    FramePacer();
+    ~FramePacer();
+
+    // Wait for the oldest frame in flight, and for the deadline in Capped mode
+    void beginFrame();
+    // The input was just read
+    void sampleInput() { inputTime = clock::now(); }
+    // Must be ran right after glfwSwapBuffers
+    void endFrame();
+
+    // In milliseconds, since the start
+    float getAverageLatency(Mode mode);
+    float getMaxLatency(Mode mode);
+    float getAverageFrameTime(Mode mode);
+    float getJitter(Mode mode); // Standard deviation of the frame time
+
+    // Log the latency and jitter of every mode that was used
+    void report();
+};
@@ -4,8 +4,11 @@
 #include "learnopengl/Camera.hpp"
 #include "testgl/constants.hpp"
 #include "testgl/logging.hpp"
+#include "testgl/voxel.hpp"
 
 #include <GLFW/glfw3.h>
+#include <mutex>
+#include <vector>
 
 class Player
 {
@@ -14,6 +17,18 @@ private:
     bool first_mouse;
     float last_x, last_y;
 
+public:
+    // Voxel clicked with the mouse, the tick thread applies it with World::pickVoxel since it owns the chunks
+    struct VoxelPick
+    {
+        glm::vec3 origin, direction;
+        Voxel value; // Air to break the voxel
+    };
+
+private:
+    std::mutex picksMutex;
+    std::vector<VoxelPick> picks;
+
 public:
     bool debugMode;
     Player(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f));
@@ -23,9 +38,11 @@ public:
     void mouse_callback(double xpos, double ypos);
     void scroll_callback(float yoffset);
     void mouse_button_callback(int button, int action, int mods);
+    // Move the picks queued since the last call to `taken`
+    void takePicks(std::vector<VoxelPick> &taken);
 
-    void setupCameraTransform(Shader *shader, uint screen_w,
-                              uint screen_h);
+    glm::mat4 getViewMatrix() { return camera.GetViewMatrix(); }
+    glm::mat4 getProjectionMatrix(uint screen_w, uint screen_h);
     void toggle_debug()
     {
         debugMode = !debugMode;
@@ -33,6 +50,7 @@ public:
         glm::vec3 front = camera.Front;
         log_debug("Player is looking at (%f, %f, %f)", front.x, front.y, front.z);
     }
+    void setPose(glm::vec3 position, float yaw, float pitch) { camera.SetPose(position, yaw, pitch); }
     glm::vec3 *getPositionPtr() { return &camera.Position; }
     glm::vec3 getPosition() { return camera.Position; }
 };
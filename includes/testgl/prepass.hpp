@@ -0,0 +1,48 @@
+#pragma once
+
+#include "learnopengl/Shaders.hpp"
+
+#include <vector>
+#include <glm/glm.hpp>
+
+class Chunk;
+
+// Optional depth-only pass drawn before the material pass
+// Once the depth buffer holds the nearest surfaces, the material shader only runs for visible fragments
+// Also counts the fragments reaching the material shader, with and without the pre-pass
+class DepthPrepass
+{
+private:
+    Shader shader;
+    // Same vertex shader as the chunks meshed for vertex pulling
+    Shader pulledShader;
+
+    // GL_SAMPLES_PASSED query around the material pass, read one frame late
+    unsigned int samplesQuery;
+    bool samplesQueryIssued;
+    // Whether the query was started by the current beginShading
+    bool countingFragments;
+    unsigned int shadedFragments;
+
+public:
+    // Toggled with F8
+    static bool enabled;
+
+    DepthPrepass();
+    ~DepthPrepass();
+
+    // Must be called once per frame before drawing
+    void beginFrame();
+
+    // Fill the depth buffer with the chunks, if enabled
+    void draw(const std::vector<Chunk *> &chunks, glm::vec3 cameraPosition);
+
+    // Surround the material pass
+    // The fragments are only counted if `countFragments` is set: the occlusion queries of OcclusionCuller
+    // cannot be issued while the sample query is active
+    void beginShading(bool countFragments);
+    void endShading();
+
+    // Fragments that passed the depth test in the material pass of a previous frame
+    unsigned int getShadedFragments() { return shadedFragments; }
+};
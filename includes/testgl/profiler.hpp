@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <glad/glad.h>
+
+#include "testgl/constants.hpp"
+
+namespace profiler
+{
+    // Stages of the tick and graphical loops that are timed
+    enum Stage : int
+    {
+        // Tick thread
+        TickDelete = 0,
+        TickLoad,
+        TickOcclusion,
+        TickMesh,
+        // Main thread
+        LockWait, // Waiting for the tick thread to release `chunksMutex`
+        Discard,
+        Upload,
+        Shadows, // GPU time is reported per cascade by ShadowCascades
+        Prepass, // Depth pre-pass, when enabled
+        Draw,
+        Lighting, // Deferred lighting pass, when enabled
+        Terrain, // Far terrain update and draw, when enabled
+        STAGE_COUNT
+    };
+
+    extern const char *stageNames[STAGE_COUNT];
+
+    // Timings of one frame, in milliseconds
+    struct FrameStats
+    {
+        float frame;
+        float cpu[STAGE_COUNT];
+        float gpu[STAGE_COUNT]; // Only the main thread stages after Discard are measured on the GPU
+    };
+
+    // Runtime switch, a disabled timer costs a single relaxed load
+    extern std::atomic<bool> enabled;
+    void toggle();
+
+    // Microseconds since the profiler started (steady clock)
+    uint64_t now();
+
+    // Name the calling thread in the exported trace
+    void setThreadName(const char *name);
+
+    // Add a CPU span to the frame accumulators and to the trace if one is being captured
+    void record(Stage stage, uint64_t start, uint64_t end);
+
+    class ScopedTimer
+    {
+    private:
+        Stage stage;
+        uint64_t start;
+        bool active;
+
+    public:
+        ScopedTimer(Stage stage) : stage(stage), start(0), active(enabled.load(std::memory_order_relaxed))
+        {
+            if (active)
+                start = now();
+        }
+        ~ScopedTimer()
+        {
+            if (active)
+                record(stage, start, now());
+        }
+    };
+
+    // GL_TIME_ELAPSED queries, they cannot be nested
+    // Must be ran from the main thread
+    void beginGpu(Stage stage);
+    void endGpu();
+
+    // Frame boundaries, must be ran from the main thread
+    // beginFrame collects the GPU queries that are ready
+    void beginFrame();
+    void endFrame(float frameTime);
+
+    // Rolling history of the last PROFILER_HISTORY frames, 0 is the last finished frame
+    const FrameStats &getFrameStats(int framesAgo);
+    // Average of the last `count` frames
+    FrameStats getAverageStats(int count);
+
+    // Chrome trace / Perfetto JSON capture of both threads
+    bool isTracing();
+    void startTrace();
+    void stopTrace(const char *path);
+    void toggleTrace();
+} // namespace profiler
+
+#if PROFILER_ENABLED
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define profile_scope(stage) profiler::ScopedTimer PROFILE_CONCAT(_profile_timer_, __LINE__)(profiler::stage)
+#define profile_gpu_begin(stage) profiler::beginGpu(profiler::stage)
+#define profile_gpu_end() profiler::endGpu()
+#else
+#define profile_scope(stage) (void)0 // No-op
+#define profile_gpu_begin(stage) (void)0
+#define profile_gpu_end() (void)0
+#endif
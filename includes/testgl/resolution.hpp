@@ -0,0 +1,54 @@
+#pragma once
+
+#include "testgl/constants.hpp"
+
+// Renders the frame off-screen at a fraction of the window size, then upscales it to the window
+// The fraction follows the GPU frame time, measured with timestamp queries, to hold RESOLUTION_TARGET_FRAME_TIME
+class DynamicResolution
+{
+private:
+    // Allocated for RESOLUTION_MAX_SCALE, smaller resolutions only use the bottom left corner
+    unsigned int FBO, colorTexture, depthRenderbuffer;
+    int windowWidth, windowHeight;
+    float scale;
+    bool scaleLocked;
+
+    // GL_TIMESTAMP at the start and the end of each frame, read RESOLUTION_GPU_LATENCY frames later
+    unsigned int queries[RESOLUTION_GPU_LATENCY][2];
+    bool issued[RESOLUTION_GPU_LATENCY];
+    int frame;
+    float gpuFrameTime; // in seconds
+
+    void createTargets();
+    void deleteTargets();
+    void adjustScale();
+
+public:
+    // Toggled with F12
+    static bool enabled;
+
+    DynamicResolution(int windowWidth, int windowHeight);
+    ~DynamicResolution();
+
+    // Follow the size of the window framebuffer
+    void resize(int windowWidth, int windowHeight);
+
+    // Stop following the frame time, for runs that must render the same image every time
+    void lockScale(float scale);
+
+    // Bind the render target and start timing the frame
+    void beginFrame();
+    // Stop timing and upscale the frame to the window
+    void endFrame();
+
+    // Framebuffer the frame must be drawn to, and its size for this frame
+    unsigned int getFramebuffer() { return enabled ? FBO : 0; }
+    int getWidth();
+    int getHeight();
+    // Largest size getWidth and getHeight can return, to allocate the other render targets
+    int getMaxWidth() { return windowWidth * RESOLUTION_MAX_SCALE; }
+    int getMaxHeight() { return windowHeight * RESOLUTION_MAX_SCALE; }
+
+    float getScale() { return enabled ? scale : 1.0f; }
+    float getGpuFrameTime() { return gpuFrameTime; }
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <glad/glad.h>
+
+// On-disk cache of linked programs (GL_ARB_get_program_binary)
+// Binaries are keyed by their sources and by the driver, a driver update invalidates every entry
+namespace shader_cache
+{
+    // Must be ran once glad is loaded, also lets the driver compile on its own threads (GL_KHR_parallel_shader_compile)
+    void init();
+
+    // Compile and link calls return before the work is done, the status must only be read when the program is needed
+    bool isParallel();
+
+    uint64_t makeKey(const std::string &vertexCode, const std::string &fragmentCode, const std::string &geometryCode);
+
+    // Replace the program with the cached binary, returns false if there is none or if the driver rejected it
+    bool load(unsigned int program, uint64_t key);
+
+    // Must be ran before linking a program that will be stored
+    void prepare(unsigned int program);
+    // Write a linked program to the cache
+    void store(unsigned int program, uint64_t key);
+
+    // Programs loaded from the cache and compiled from source since the start
+    int getHits();
+    int getMisses();
+} // namespace shader_cache
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "learnopengl/Shaders.hpp"
+#include "testgl/chunkpos.hpp"
+#include "testgl/constants.hpp"
+#include "testgl/frameuniforms.hpp"
+
+#include <map>
+#include <vector>
+#include <glm/glm.hpp>
+
+class Chunk;
+
+// Cascaded shadow maps of the sun, stored in the layers of a depth texture array
+// Each cascade covers a sphere around the camera, the first one is rendered every frame
+// The others are cached and only rendered again when the camera leaves their margin,
+// when the sun turned past SHADOW_ANGLE_THRESHOLD or when a chunk remeshed in their footprint
+class ShadowCascades
+{
+private:
+    // std140 layout of the `Shadows` uniform block
+    struct GPUShadows
+    {
+        glm::mat4 matrices[SHADOW_CASCADES]; // World to shadow map coordinates, in [0, 1]
+        glm::vec4 splits;                    // Distance from the camera covered by each cascade, 0 when disabled
+        glm::vec4 texelSizes;                // in voxels, for the normal offset
+    };
+    static_assert(SHADOW_CASCADES <= 4, "The cascade splits are packed in a vec4");
+
+    struct Cascade
+    {
+        glm::vec3 center;
+        float radius;
+        glm::vec3 direction; // Towards the sun
+        glm::mat4 view, projection;
+        bool valid;
+        bool dirty; // A chunk in the footprint changed
+
+        // GL_TIME_ELAPSED of the last render, read once available
+        unsigned int query;
+        bool queryIssued;
+        float gpuTime;    // in ms, summed over the timed renders until resetStats
+        int renders;      // every render, only the ones that found the query free are timed
+        int timedRenders;
+    };
+
+    Cascade cascades[SHADOW_CASCADES];
+    float splits[SHADOW_CASCADES];
+
+    unsigned int FBO, depthTexture;
+    unsigned int UBO;
+
+    // Depth only programs, reading the camera of each cascade from its own Frame block
+    Shader shader;
+    Shader pulledShader;
+    FrameUniforms cascadeFrames[SHADOW_CASCADES];
+    // Bound again after rendering the cascades
+    FrameUniforms *frameUniforms;
+
+    glm::vec3 cameraPosition;
+    glm::vec3 sunDirection;
+
+    // Whether a box, in world space, can cast a shadow in the cascade
+    bool intersects(const Cascade &cascade, glm::vec3 boxMin, glm::vec3 boxMax);
+    void fit(Cascade &cascade, float radius);
+    void renderCascade(int index, const std::map<ChunkPos, Chunk *> &chunks);
+    void upload();
+
+public:
+    // Toggled with F11
+    static bool enabled;
+
+    ShadowCascades(FrameUniforms *frameUniforms);
+    ~ShadowCascades();
+
+    // Attach the `Shadows` uniform block and the shadow map to a lit program
+    static void attach(Shader *shader);
+
+    // Must be called once per frame, `sunDirection` points towards the sun
+    void beginFrame(glm::vec3 cameraPosition, glm::vec3 sunDirection);
+
+    // Render the cascades that need it, `remeshed` holds the chunks uploaded since the last call
+    // Must be ran from the main thread with the chunks locked
+    void render(const std::map<ChunkPos, Chunk *> &chunks, const std::vector<ChunkPos> &remeshed);
+
+    // Average GPU time of the timed renders of a cascade in ms, and number of renders, since the last resetStats
+    float getCascadeTime(int index) { return cascades[index].timedRenders ? cascades[index].gpuTime / cascades[index].timedRenders : 0.0f; }
+    int getCascadeRenders(int index) { return cascades[index].renders; }
+    void resetStats();
+};
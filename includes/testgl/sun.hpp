@@ -15,8 +15,8 @@ private:
     float diffuse;
     float specular;
 
-    glm::mat4 view;
-    glm::mat4 projection;
+    // Towards the sun, from the player
+    glm::vec3 direction;
 
     float currentTime;
 
@@ -27,4 +27,8 @@ public:
     ~Sun();
 
     void update(float delta_time, glm::vec3 player_position);
+    // Set the light colors of another program
+    void setupShader(Shader *shader);
+    glm::vec3 getPosition() { return position; }
+    glm::vec3 getDirection() { return direction; }
 };
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <chrono>
+
+#include "testgl/constants.hpp"
+
+// Fixed timestep scheduler for the tick thread, based on an accumulator
+// Late ticks are caught up (up to MAX_TICK_CATCH_UP), with a reduced work budget
+class TickScheduler
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+private:
+    clock::duration period;
+    clock::duration accumulator;
+    clock::time_point previous;
+
+public:
+    TickScheduler(int ticksPerSecond = TICKS_PER_SECOND);
+
+    // Wait until a tick is due, and return the time by which its work should be done
+    clock::time_point beginTick();
+
+    clock::duration getPeriod() { return period; }
+};
+
+// Adaptive estimate of the time a tick stage takes per chunk
+// Used to size the work of each stage to the remaining tick budget
+class StageCost
+{
+private:
+    float perChunk; // in seconds
+
+public:
+    StageCost(float initial = TICK_STAGE_INITIAL_COST) : perChunk(initial) {}
+
+    // Number of chunks that should fit in `budget`, always at least one so that the stage makes progress
+    int chunksFor(TickScheduler::clock::duration budget);
+
+    // Feed the measured time of `chunks` chunks
+    void update(TickScheduler::clock::duration elapsed, int chunks);
+
+    float getPerChunk() { return perChunk; }
+};
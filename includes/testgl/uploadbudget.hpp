@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+#include "testgl/constants.hpp"
+
+// Decides how many bytes of meshes can be sent to the GPU each frame
+// The budget is a share of the target frame time, converted to bytes with the measured upload throughput,
+// and shrinks when the previous frame was already over the target
+class UploadBudget
+{
+private:
+    float throughput; // in bytes per second, moving average
+
+    // Statistics since the last reset
+    size_t totalBytes;
+    size_t maxFrameBytes;
+    int frames;
+    int spikes; // frames over UPLOAD_SPIKE_FACTOR times the target that followed an upload
+    size_t lastFrameBytes;
+
+public:
+    UploadBudget();
+
+    // Bytes that can be uploaded during this frame, given the duration of the previous one
+    size_t nextFrame(float previousFrameTime);
+
+    // Feed the bytes uploaded during the frame and the time it took
+    void update(size_t bytes, float seconds);
+
+    float getThroughput() { return throughput; }
+
+    // Statistics
+    float getAverageBytesPerFrame() { return frames ? (float)totalBytes / frames : 0.0f; }
+    size_t getMaxBytesPerFrame() { return maxFrameBytes; }
+    int getSpikes() { return spikes; }
+    void resetStats();
+};
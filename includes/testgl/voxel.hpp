@@ -1,5 +1,7 @@
 #pragma once
 
+#include "testgl/constants.hpp"
+
 enum Voxel : unsigned char
 {
     Air = 0,
@@ -7,8 +9,15 @@ enum Voxel : unsigned char
     Grass = 2,
     Sand = 3,
     Water = 4,
+    Lamp = 5,
 };
 
+// Block light level emitted by a voxel, from 0 to MAX_LIGHT_LEVEL
+inline int voxelEmission(Voxel voxel)
+{
+    return voxel == Voxel::Lamp ? MAX_LIGHT_LEVEL : 0;
+}
+
 #include <glm/glm.hpp>
 
 #include "learnopengl/Shaders.hpp"
@@ -56,20 +65,31 @@ namespace ShaderData
          .specular = vec3(0.9f, 0.9f, 1.0f),
          .shininess = 512.0f,
          .flow = true},
+        // Lamp
+        {.ambient = vec3(1.0f, 0.85f, 0.6f),
+         .diffuse = vec3(1.0f, 0.85f, 0.6f),
+         .specular = vec3(0.0f, 0.0f, 0.0f),
+         .shininess = 1.0f,
+         .flow = false},
     };
 
-    // Setup function to load the materials into the shader
-    inline void setupMaterials(Shader *shader)
+    // std140 layout of `Material` in the `Materials` uniform block, 64 bytes per entry
+    struct alignas(16) GPUMaterial
     {
-        shader->use();
-        for (int i = 0; i < sizeof(materials) / sizeof(Material); i++)
-        {
-            shader->setVec3("materials[" + std::to_string(i) + "].ambient", materials[i].ambient);
-            shader->setVec3("materials[" + std::to_string(i) + "].diffuse", materials[i].diffuse);
-            shader->setVec3("materials[" + std::to_string(i) + "].specular", materials[i].specular);
-            shader->setFloat("materials[" + std::to_string(i) + "].shininess", materials[i].shininess);
-            shader->setBool("materials[" + std::to_string(i) + "].flow", materials[i].flow);
-        }
-    }
+        vec4 ambient;
+        vec4 diffuse;
+        vec3 specular;
+        float shininess;
+        int flow;
+        int padding[3];
+    };
+    static_assert(sizeof(GPUMaterial) == 64, "GPUMaterial must match the std140 layout");
+
+    // Attach the `Materials` uniform block of a shader to the shared material buffer
+    // The buffer is created and filled from `materials` the first time
+    void setupMaterials(Shader *shader);
+
+    // Replace one entry of the material buffer, a single buffer update
+    void updateMaterial(int index, const Material &material);
 
 } // namespace ShaderData
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "testgl/voxel.hpp"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// A voxel that was replaced, in world coordinates, for the light updates of the bulk edits
+struct VoxelChange
+{
+    int x, y, z;
+    Voxel before;
+};
+
+// Box of voxels written at once by World::fill and World::paste
+// Either every voxel is the same (a shape to fill) or they are stored (a copy), the optional mask
+// tells which voxels of the box are written, so that a sphere or a copy without its air only writes its own voxels
+// Voxels are stored x first, then y, then z
+class VoxelRegion
+{
+private:
+    glm::ivec3 size;
+    std::vector<Voxel> voxels; // Empty when the whole region is `fillVoxel`
+    Voxel fillVoxel;
+    std::vector<uint8_t> mask; // Empty when the whole box is written
+
+public:
+    VoxelRegion(glm::ivec3 size, Voxel fillVoxel = Voxel::Air);
+
+    // Shapes, to be filled with World::fill
+    static VoxelRegion box(glm::ivec3 size);
+    // Box of 2 * radius + 1 voxels, centered on its middle voxel
+    static VoxelRegion sphere(int radius);
+    // Only the voxels where `mask` is not 0, `mask` has one entry per voxel of the box
+    static VoxelRegion masked(glm::ivec3 size, std::vector<uint8_t> mask);
+
+    // Leave the voxels that are air out of the mask, so that pasting keeps what is around the copied shape
+    void maskAir();
+
+    glm::ivec3 getSize() const { return size; }
+    int index(int x, int y, int z) const { return x + size.x * (y + size.y * z); }
+
+    // Same voxel everywhere, see getFillVoxel
+    bool isUniform() const { return voxels.empty(); }
+    Voxel getFillVoxel() const { return fillVoxel; }
+    Voxel get(int x, int y, int z) const { return voxels.empty() ? fillVoxel : voxels[index(x, y, z)]; }
+    void set(int x, int y, int z, Voxel voxel);
+    // A row of size.x voxels, nullptr when the region is uniform
+    const Voxel *getRow(int y, int z) const { return voxels.empty() ? nullptr : &voxels[index(0, y, z)]; }
+
+    bool isMasked() const { return !mask.empty(); }
+    bool isWritten(int x, int y, int z) const { return mask.empty() || mask[index(x, y, z)]; }
+    // A row of size.x mask entries, nullptr when the whole box is written
+    const uint8_t *getMaskRow(int y, int z) const { return mask.empty() ? nullptr : &mask[index(0, y, z)]; }
+};
@@ -20,7 +20,13 @@ public:
     // Allow the window to be used as a GLFWwindow pointer
     operator GLFWwindow *() const { return window; }
 
-    static int initGLFW();
+    // Size of the default framebuffer, kept up to date by glfw_framebuffer_size_callback
+    static int framebufferWidth, framebufferHeight;
+
+    // Rendering without a display, the window is never shown (see headless.hpp)
+    static bool headless;
+
+    static int initGLFW(bool headless = false);
     static int initGLAD();
 
     bool shouldClose();
@@ -3,15 +3,26 @@
 #define GLM_ENABLE_EXPERIMENTAL
 
 #include <map>
+#include <atomic>
 #include <tuple>
 #include <mutex>
 #include <queue>
+#include <vector>
+#include <unordered_set>
 #include <glm/glm.hpp>
 #include <glm/gtx/norm.hpp>
 
 #include "testgl/chunk.hpp"
+#include "testgl/chunkhandle.hpp"
 #include "testgl/constants.hpp"
+#include "testgl/light.hpp"
 #include "testgl/worldgen.hpp"
+#include "testgl/tickscheduler.hpp"
+#include "testgl/voxelregion.hpp"
+#include "testgl/uploadbudget.hpp"
+#include "testgl/occlusion.hpp"
+#include "testgl/prepass.hpp"
+#include "testgl/shadows.hpp"
 
 class Chunk;
 
@@ -23,6 +34,25 @@ private:
 
     std::mutex chunksMutex;
 
+    // Handles of the loaded chunks, the queues only hold handles so that
+    // deleting a chunk does not require touching them
+    ChunkHandleTable chunkHandles;
+
+    // Sky and block light across the chunk borders and after voxel changes
+    LightEngine lightEngine;
+    LightWorkers lightWorkers;
+    // Chunks created since their light was last calculated
+    std::vector<ChunkHandle> chunksToLight;
+
+    // Calculate the light of the new chunks on the light workers, then connect it to their neighbors
+    void lightNewChunks();
+    // Mesh again the chunks whose light changed
+    void remeshLitChunks();
+
+    // Write a region into every loaded chunk it overlaps, then update the light of all the replaced voxels at once
+    // `fill` replaces the voxels of the region when not nullptr
+    void writeRegion(glm::ivec3 origin, const VoxelRegion &region, const Voxel *fill);
+
     // Pointer to the player position vector
     glm::vec3 *playerPos;
 
@@ -32,6 +62,35 @@ private:
     // World generation function
     WorldGenerator::function_t worldGenerator;
 
+    // Optional, chunks hidden behind terrain are skipped when set
+    OcclusionCuller *occlusionCuller;
+
+    // Optional, fills the depth buffer before the material pass
+    DepthPrepass *depthPrepass;
+
+    // Program drawing the chunks meshed for vertex pulling
+    Shader *pulledShader;
+
+    // Optional, sun shadow maps rendered before drawing
+    ShadowCascades *shadowCascades;
+    // Chunks whose new mesh was uploaded this frame, the cached shadow maps around them are outdated
+    std::vector<ChunkPos> uploadedChunks;
+
+    // Mesh memory of the chunks in `visibleChunks`, updated every frame
+    size_t visibleMeshBytes;
+    int visibleFaces;
+
+    // Sum the memory of the loaded chunks into voxelBytes, denseVoxelBytes, lightBytes and chunkBytes
+    // Must be ran from the thread that owns the chunks
+    void updateVoxelStats();
+
+    // Chunks reachable from the camera through the chunk face connectivity graph, filled every frame
+    std::vector<Chunk *> visibleChunks;
+    void findVisibleChunks();
+
+    // Sort `visibleChunks` front to back so that the nearest surfaces fill the depth buffer first
+    void sortVisibleChunks();
+
     // Fill the priority queue with chunks to load
     void nextChunkToLoad();
 
@@ -46,7 +105,7 @@ private:
 
     // Loading priority stuff:
     typedef std::pair<ChunkPos, int> ChunkPosWithDist; // ChunkPos with distance from player
-    typedef std::pair<Chunk *, int> ChunkWithDist;     // Chunk with distance from player
+    typedef std::pair<ChunkHandle, int> ChunkWithDist; // Chunk handle with distance from player
     // Comparison function for the priority queues
     struct ChunkWithDistCompare
     {
@@ -82,6 +141,13 @@ private:
     ChunkPosWithDist makeChunkPosWithDist(ChunkPos pos);
     ChunkWithDist makeChunkWithDist(Chunk *chunk);
 
+    // Estimated cost per chunk of each tick stage
+    StageCost loadCost, occlusionCost, meshCost;
+
+    // Run a tick stage on as many chunks as its share of the time left before `deadline` allows
+    // Returns the number of chunks processed
+    int runStage(int (World::*stage)(int), StageCost &cost, TickScheduler::clock::time_point deadline, int stagesLeft);
+
 public:
     // World constructor
     World(glm::vec3 *playerPos, WorldGenerator::function_t worldGenerator);
@@ -89,14 +155,52 @@ public:
     // "Now I am become Death, the Destroyer of Worlds” - Sanskrit
     ~World();
 
-    // Set a voxel value anywhere inside the loaded chunks
+    // Set a voxel value anywhere inside the loaded chunks, the light around it is updated right away
     // Returns false if the position is outside loaded chunks
+    // Must be ran from the tick thread
     bool setVoxel(int x, int y, int z, Voxel value);
 
+    // Bulk edits: each chunk they touch is written once, relit in one pass and meshed once
+    // `origin` is the world position of the lower corner of the region, the voxels outside the loaded chunks are skipped
+    // Must be ran from the tick thread
+    void fill(glm::ivec3 origin, const VoxelRegion &shape, Voxel value);
+    // Both corners are included
+    void fillBox(glm::ivec3 min, glm::ivec3 max, Voxel value);
+    void fillSphere(glm::ivec3 center, int radius, Voxel value);
+    // Both corners are included, the voxels outside the loaded chunks are copied as air
+    VoxelRegion copy(glm::ivec3 min, glm::ivec3 max);
+    // Write the voxels of a copy, see VoxelRegion::maskAir to keep what is around it
+    void paste(glm::ivec3 origin, const VoxelRegion &region);
+
+    // Voxel hit by a ray and the face the ray entered it through
+    struct RaycastHit
+    {
+        glm::ivec3 voxel;
+        glm::ivec3 normal; // Outward normal of the face, zero if the ray starts inside the voxel
+        Side face;         // Same as `normal`, Side::NONE if the ray starts inside the voxel
+        float distance;    // in voxels, from the origin of the ray to the face
+        Voxel value;
+    };
+
+    // Walk a ray through the voxels (Amanatides & Woo) until it hits one that is not air, up to `maxDistance` voxels
+    // Empty chunks, bricks of air and chunks that are not loaded are crossed in one step
+    // Returns false if nothing was hit
+    // Must be ran from the tick thread
+    bool raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance, RaycastHit *hit);
+
+    // Break the voxel a ray hits within PICK_REACH, or place `value` against the face it hits when it is not air
+    // Returns false if nothing was hit or changed
+    // Must be ran from the tick thread
+    bool pickVoxel(glm::vec3 origin, glm::vec3 direction, Voxel value);
+
     // Get a voxel value anywhere inside the loaded chunks
     // Returns VOXEL_INVALID if the position is outside loaded chunks
     Voxel getVoxel(int x, int y, int z);
 
+    // Get a light level anywhere inside the loaded chunks
+    // Returns -1 if the position is outside loaded chunks
+    int getLight(int x, int y, int z, LightChannel channel);
+
     // Check if a chunk is loaded
     bool isChunkLoaded(ChunkPos pos);
 
@@ -104,23 +208,53 @@ public:
     // Must be ran from the main thread
     void draw(Shader *shader);
 
+    // Use hardware occlusion queries when drawing, nullptr to disable
+    void setOcclusionCuller(OcclusionCuller *culler) { occlusionCuller = culler; }
+
+    // Draw a depth-only pass before the material pass, nullptr to disable
+    void setDepthPrepass(DepthPrepass *prepass) { depthPrepass = prepass; }
+
+    // Program used for the chunks meshed with Chunk::vertexPulling, must be set before such chunks are drawn
+    void setPulledShader(Shader *shader) { pulledShader = shader; }
+
+    // Render the sun shadow maps every frame, nullptr to disable
+    void setShadowCascades(ShadowCascades *shadows) { shadowCascades = shadows; }
+
+    // Set from the main thread, the tick thread then meshes every chunk again
+    static std::atomic<bool> remeshRequested;
+    size_t getVisibleMeshBytes() { return visibleMeshBytes; }
+    int getVisibleFaces() { return visibleFaces; }
+
+    // Only draw the chunks the camera can see through air (toggled with F7)
+    static bool visibilityCulling;
+    int getVisibleChunks() { return visibleChunks.size(); }
+
     // Load the `numberOfChunks` due chunks closest to the player
-    void loadChunks(int numberOfChunks);
+    // Returns the number of chunks loaded
+    int loadChunks(int numberOfChunks);
 
     // Update the side occlusion map for the `numberOfChunks` due chunks closest to the player
-    void updateSideOcclusion(int numberOfChunks);
+    // Returns the number of chunks updated
+    int updateSideOcclusion(int numberOfChunks);
 
     // Update the mesh for the `numberOfChunks` due chunks closest to the player
-    void updateMesh(int numberOfChunks);
+    // Returns the number of chunks meshed
+    int updateMesh(int numberOfChunks);
 
-    // Upload the mesh of the `numberOfChunks` due chunks closest to the player
+    // Upload up to `byteBudget` bytes of the due meshes closest to the player
+    // Returns the number of bytes uploaded
     // Must be ran from the main thread
-    void uploadMesh(int numberOfChunks);
+    size_t uploadMesh(size_t byteBudget);
 
     // Loads all the chunks at once, for the first time
     // Must be ran from the main thread
     void loadAllChunks();
 
+    // Follow the player and build everything that is due, without any time budget
+    // Used by the headless runs so that the world only depends on the camera path
+    // Must be ran from the main thread, without the tick thread
+    void settle();
+
     // Discard buffers for chunks that are too far away and schedule them for deletion
     // Must be ran from the main thread
     void discardChunks();
@@ -129,12 +263,17 @@ public:
     void deleteChunks();
 
     // Load chunks, calculate side occlusion, generate meshes
+    // The amount of work is sized to end by `deadline`
     // This is the main loop, ran on a separate thread
-    void tick();
+    void tick(TickScheduler::clock::time_point deadline);
 
     // Upload meshes to GPU, draw chunks
+    // The upload budget depends on how long the previous frame took
     // This is the graphical loop, ran on the main thread
-    void graphicalTick(Shader *shader);
+    void graphicalTick(Shader *shader, float previousFrameTime);
+
+    // Per frame byte budget and statistics of the mesh uploads
+    UploadBudget uploadBudget;
 
     // Number of ticks since the world was created
     int nTicks = 0;
@@ -142,6 +281,21 @@ public:
     // Number of loaded chunks
     int getLoadedChunks() { return chunks.size(); }
 
+    // Work done by loadAllChunks (start and headless runs), the times are in milliseconds
+    struct BuildStats
+    {
+        int generatedChunks = 0, meshedChunks = 0;
+        float generationTime = 0.0f, meshingTime = 0.0f;
+    };
+    BuildStats buildStats;
+
+    // Memory of the voxels of the loaded chunks, and what they would take as dense arrays, updated every tick
+    std::atomic<size_t> voxelBytes, denseVoxelBytes;
+    // Memory of the light of the loaded chunks, updated every tick
+    std::atomic<size_t> lightBytes;
+    // Whole CPU memory of the loaded chunks (Chunk::getBytes), updated every tick
+    std::atomic<size_t> chunkBytes;
+
     // Put functions for the priority queues here
     // They are public so they can be used by the chunks themselves
     void addToLoadQueue(ChunkPos pos);
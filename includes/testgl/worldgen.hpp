@@ -17,4 +17,9 @@ namespace WorldGenerator
 
     void full(ChunkPos pos, ChunkData voxels, Voxel *simpleChunkVoxel, bool *isSimpleChunk);
     void classic(ChunkPos pos, ChunkData voxels, Voxel *simpleChunkVoxel, bool *isSimpleChunk);
+
+    // Height of the `classic` terrain at a column, the voxels below it are solid
+    int classicHeight(int x, int z);
+    // Top of the `classic` terrain at a column, water included: the height of its upper face and its voxel
+    void classicSurface(int x, int z, float *height, Voxel *voxel);
 } // namespace WorldGenerator
\ No newline at end of file
@@ -1,7 +1,6 @@
 #version 330 core
 
-#define NUM_MATERIALS 255 // Can be reduced to 5 for now to save memory
-// Do not forget to increase if the type of the enum Voxel is changed.
+#define NUM_MATERIALS 256 // Must match MATERIAL_COUNT in constants.hpp
 
 
 #define FLOW_SPEED 2.0
@@ -9,8 +8,16 @@
 #define FLOW_SPREAD 3.0
 #define FLOW_LAYERS 4
 
+#define OCCLUSION_FLOOR 0.35 // Ambient light left in a fully occluded corner, must match lighting.frag
+#define LIGHT_FALLOFF 0.8 // Intensity kept by each light level from the one above, must match lighting.frag
+#define BLOCK_LIGHT_COLOR vec3(1.0, 0.8, 0.55) // Must match lighting.frag
+
+#define SHADOW_CASCADES 3 // Must match SHADOW_CASCADES in constants.hpp
+
 flat in int material; // Receive the color from the vertex shader
 flat in vec3 normalRaw;
+in float ambientOcclusion; // Baked per corner by the mesher
+in vec2 voxelLight; // Sky and block light levels, baked per corner by the mesher
 in vec3 FragPos;
 
 out vec4 FragColor;
@@ -24,17 +31,55 @@ struct Material {
 }; 
 
 struct Light {
-    vec3 position;
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
 };
 
 
-uniform Material materials[NUM_MATERIALS];
-uniform vec3 viewPos;
+// Shared by every program, filled by ShaderData::setupMaterials
+layout (std140) uniform Materials {
+    Material materials[NUM_MATERIALS];
+};
 uniform Light light;
-uniform float time;
+
+// Written once per frame by FrameUniforms
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float time;
+    vec3 lightPosition;
+};
+
+// Filled by ShadowCascades
+uniform sampler2DArrayShadow shadowMap;
+layout (std140) uniform Shadows {
+    mat4 shadowMatrices[SHADOW_CASCADES];
+    vec4 cascadeSplits; // Distance from the camera covered by each cascade, 0 when disabled
+    vec4 cascadeTexelSizes;
+};
+
+// 1.0 when lit by the sun, 0.0 in its shadow
+float sunShadow(vec3 position, vec3 normal)
+{
+    float cameraDistance = length(viewPos - position);
+    for (int i = 0; i < SHADOW_CASCADES; i++) {
+        if (cameraDistance < cascadeSplits[i]) {
+            // Push the position along the normal to avoid shadow acne
+            vec4 coord = shadowMatrices[i] * vec4(position + normal * cascadeTexelSizes[i] * 1.5, 1.0);
+            return texture(shadowMap, vec4(coord.xy, float(i), coord.z));
+        }
+    }
+    return 1.0;
+}
+
+// Light level from 0 to 1 to an intensity, each level is about LIGHT_FALLOFF times dimmer than the next one
+// and level 0 is dark
+float lightIntensity(float level)
+{
+    return level * pow(LIGHT_FALLOFF, (1.0 - level) * 15.0);
+}
 
 void main()
 {   
@@ -63,12 +108,14 @@ void main()
     }
 
 
-    // ambient
-    vec3 ambient = light.ambient * currentMaterial.ambient;
+    // ambient, the sky light is how much of the sky the voxel sees
+    float occlusion = mix(OCCLUSION_FLOOR, 1.0, ambientOcclusion);
+    float skyLight = lightIntensity(voxelLight.x);
+    vec3 ambient = light.ambient * currentMaterial.ambient * occlusion * skyLight;
   	
     // diffuse 
     vec3 norm = normalize(normal);
-    vec3 lightDir = normalize(light.position - FragPos);
+    vec3 lightDir = normalize(lightPosition - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
     vec3 diffuse = light.diffuse * (diff * currentMaterial.diffuse);
     
@@ -78,7 +125,10 @@ void main()
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), currentMaterial.shininess);
     vec3 specular = light.specular * (spec * currentMaterial.specular);  
         
-    vec3 result = ambient + diffuse + specular;
+    // block light, from the emitting voxels nearby
+    vec3 block = BLOCK_LIGHT_COLOR * currentMaterial.diffuse * occlusion * lightIntensity(voxelLight.y);
+
+    vec3 result = ambient + block + skyLight * sunShadow(FragPos, norm) * (diffuse + specular);
     FragColor = vec4(result, 1.0);
     //FragColor = vec4(normal.xyz, 1.0);
 
@@ -1,20 +1,34 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;   // Vertex position
-layout (location = 1) in int aMaterial; // Vertex color index
+layout (location = 1) in int aMaterial; // Vertex color index, with the ambient occlusion and the light on the bits above (see packVertexColor)
 layout (location = 2) in vec3 aNormal; // Vertex normal
 
 flat out int material; // Output a color index to the fragment shader
 flat out vec3 normalRaw; // Output a normal to the fragment shader
+out float ambientOcclusion; // 0 in a fully occluded corner, 1 in the open
+out vec2 voxelLight; // Sky and block light levels, from 0 to 1
 out vec3 FragPos; // Output a position to the fragment shader
 
+// The depth pre-pass (depth.vert) must compute the exact same depth
+invariant gl_Position;
+
 uniform mat4 model;
 uniform mat4 inv_model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// Written once per frame by FrameUniforms
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float time;
+    vec3 lightPosition;
+};
 
 void main()
 {
-    material = aMaterial;
+    material = aMaterial & 255;
+    ambientOcclusion = float((aMaterial >> 8) & 3) / 3.0;
+    voxelLight = vec2((aMaterial >> 10) & 15, (aMaterial >> 14) & 15) / 15.0;
     FragPos = vec3(model * vec4(aPos, 1.0));
     normalRaw = aNormal;
     
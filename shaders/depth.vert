@@ -0,0 +1,22 @@
+#version 330 core
+layout (location = 0) in vec3 aPos; // Vertex position
+
+// Must be computed exactly like in base.vert so that the depth matches
+invariant gl_Position;
+
+uniform mat4 model;
+
+// Written once per frame by FrameUniforms
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float time;
+    vec3 lightPosition;
+};
+
+void main()
+{
+    vec3 FragPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#version 330 core
+
+#define NUM_MATERIALS 256 // Must match MATERIAL_COUNT in constants.hpp
+
+#define FOG_COLOR vec3(0.1, 0.3, 0.75) // Must match the clear color in window.cpp
+#define FOG_DENSITY 0.00002 // Inverse of the distance where about two thirds of the color is fog
+
+flat in int material;
+flat in vec4 hole;
+in vec3 normal;
+in vec3 FragPos;
+
+out vec4 FragColor;
+
+struct Material {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float shininess;
+    bool flow;
+};
+
+struct Light {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// Shared by every program, filled by ShaderData::setupMaterials
+layout (std140) uniform Materials {
+    Material materials[NUM_MATERIALS];
+};
+uniform Light light;
+
+// Written once per frame by FrameUniforms
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float time;
+    vec3 lightPosition;
+};
+
+uniform vec4 voxelArea; // Area drawn by the chunks, min x, min z, max x, max z
+
+bool inside(vec2 position, vec4 area)
+{
+    return all(greaterThan(position, area.xy)) && all(lessThan(position, area.zw));
+}
+
+void main()
+{
+    // Drawn by the finer level or by the chunks
+    if (inside(FragPos.xz, hole) || inside(FragPos.xz, voxelArea))
+        discard;
+
+    Material currentMaterial = materials[material];
+    vec3 norm = normalize(normal);
+
+    // The sun is far away, its direction is the same for the whole terrain
+    vec3 lightDir = normalize(lightPosition - viewPos);
+    vec3 ambient = light.ambient * currentMaterial.ambient;
+    vec3 diffuse = light.diffuse * (max(dot(norm, lightDir), 0.0) * currentMaterial.diffuse);
+
+    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), currentMaterial.shininess);
+    vec3 specular = light.specular * (spec * currentMaterial.specular);
+
+    // Fades into the sky towards the horizon
+    float cameraDistance = length(viewPos - FragPos) * FOG_DENSITY;
+    float fog = exp(-cameraDistance * cameraDistance);
+    FragColor = vec4(mix(FOG_COLOR, ambient + diffuse + specular, fog), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#version 330 core
+
+#define CLIPMAP_LEVELS 8 // Must match CLIPMAP_LEVELS in constants.hpp
+#define CLIPMAP_SIZE 128 // Must match CLIPMAP_SIZE in constants.hpp
+#define CLIPMAP_GRID (CLIPMAP_SIZE - 1)
+
+layout (location = 0) in vec2 aGrid; // Sample coordinates inside the level, the level is the instance
+
+flat out int material;
+flat out vec4 hole; // Area drawn by the finer level, min x, min z, max x, max z
+out vec3 normal;
+out vec3 FragPos;
+
+// Written once per frame by FrameUniforms
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float time;
+    vec3 lightPosition;
+};
+
+// Height and voxel of each sample, one layer per level, addressed toroidally
+uniform sampler2DArray heights;
+uniform ivec2 origins[CLIPMAP_LEVELS]; // Lower corner of each level, in samples of that level
+uniform float spacing; // Distance between the samples of the finest level
+uniform float morphBand; // Part of the level, from its border, that blends towards the coarser level
+uniform mat4 farProjection; // Same as `projection`, with the depth range of the clipmap
+
+vec2 fetch(int level, ivec2 coord)
+{
+    return texelFetch(heights, ivec3(coord & (CLIPMAP_SIZE - 1), level), 0).rg;
+}
+
+void main()
+{
+    int level = gl_InstanceID;
+    ivec2 grid = ivec2(aGrid);
+    ivec2 coord = origins[level] + grid;
+    float levelSpacing = spacing * float(1 << level);
+
+    vec2 surface = fetch(level, coord);
+    float height = surface.r;
+    material = int(surface.g);
+
+    // Near the border, the vertices move to the surface of the coarser level so that both meet
+    // The odd vertices lie between two coarse samples (four on the diagonal)
+    if (level < CLIPMAP_LEVELS - 1) {
+        vec2 fromCenter = abs(aGrid - float(CLIPMAP_GRID - 1) * 0.5) / (float(CLIPMAP_GRID - 1) * 0.5);
+        float morph = clamp((max(fromCenter.x, fromCenter.y) - (1.0 - morphBand)) / morphBand, 0.0, 1.0);
+        if (morph > 0.0) {
+            ivec2 low = coord >> 1;
+            ivec2 high = (coord + 1) >> 1;
+            float coarse = (fetch(level + 1, low).r + fetch(level + 1, ivec2(high.x, low.y)).r +
+                            fetch(level + 1, ivec2(low.x, high.y)).r + fetch(level + 1, high).r) * 0.25;
+            height = mix(height, coarse, morph);
+        }
+    }
+
+    // Normal from the neighboring samples, clamped to the level
+    ivec2 first = origins[level];
+    ivec2 last = first + CLIPMAP_GRID - 1;
+    float left = fetch(level, ivec2(max(coord.x - 1, first.x), coord.y)).r;
+    float right = fetch(level, ivec2(min(coord.x + 1, last.x), coord.y)).r;
+    float back = fetch(level, ivec2(coord.x, max(coord.y - 1, first.y))).r;
+    float front = fetch(level, ivec2(coord.x, min(coord.y + 1, last.y))).r;
+    normal = normalize(vec3(left - right, 2.0 * levelSpacing, back - front));
+
+    // The finest level draws everything down to the chunks
+    hole = vec4(0.0);
+    if (level > 0) {
+        float finerSpacing = levelSpacing * 0.5;
+        vec2 finerMin = vec2(origins[level - 1]) * finerSpacing;
+        hole = vec4(finerMin, finerMin + float(CLIPMAP_GRID - 1) * finerSpacing);
+    }
+
+    FragPos = vec3(float(coord.x) * levelSpacing, height, float(coord.y) * levelSpacing);
+    gl_Position = farProjection * view * vec4(FragPos, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#version 330 core
+
+#define NUM_MATERIALS 256 // Must match MATERIAL_COUNT in constants.hpp
+
+#define FLOW_SPEED 2.0
+#define FLOW_AMPLITUDE 0.005
+#define FLOW_SPREAD 3.0
+#define FLOW_LAYERS 4
+
+// Geometry pass of the deferred path, the lighting is done by lighting.frag
+flat in int material; // Receive the color from the vertex shader
+flat in vec3 normalRaw;
+in float ambientOcclusion; // Baked per corner by the mesher
+in vec2 voxelLight; // Sky and block light levels, baked per corner by the mesher
+in vec3 FragPos;
+
+layout (location = 0) out vec4 gNormal; // n * 0.5 + 0.5
+layout (location = 1) out uvec4 gMaterial; // Material index, then ambient occlusion, sky and block light * 255
+
+struct Material {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float shininess;
+    bool flow;
+};
+
+// Shared by every program, filled by ShaderData::setupMaterials
+layout (std140) uniform Materials {
+    Material materials[NUM_MATERIALS];
+};
+
+// Written once per frame by FrameUniforms
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float time;
+    vec3 lightPosition;
+};
+
+void main()
+{
+    // Same flowing normal as base.frag
+    vec3 normal = normalRaw;
+    if (materials[material].flow) {
+        float flowTime = time * FLOW_SPEED;
+        float flowAmplitude = FLOW_AMPLITUDE;
+        float flowSpread = FLOW_SPREAD;
+        float flow = 0.0;
+        float side = -1;
+        float side2 = 1;
+        for (int i = 0; i < FLOW_LAYERS; i++) {
+            flow += sin(flowTime + FragPos.x * flowSpread * side2 + FragPos.y * flowSpread + FragPos.z * flowSpread * side) * flowAmplitude;
+            flowTime *= 1.2;
+            flowAmplitude *= 0.65;
+            flowSpread *= 0.2;
+            side *= -1.1;
+            side2 *= -1.2;
+        }
+        normal += vec3(flow, 0.0, flow);
+        normal = normalize(normal);
+    }
+
+    gNormal = vec4(normal * 0.5 + 0.5, 1.0);
+    gMaterial = uvec4(material, uvec3(vec3(ambientOcclusion, voxelLight) * 255.0 + 0.5));
+}
\ No newline at end of file
@@ -0,0 +1,149 @@
+#version 330 core
+
+#define NUM_MATERIALS 256 // Must match MATERIAL_COUNT in constants.hpp
+#define MAX_POINT_LIGHTS 128 // Must match MAX_POINT_LIGHTS in constants.hpp
+#define SHADOW_CASCADES 3 // Must match SHADOW_CASCADES in constants.hpp
+#define OCCLUSION_FLOOR 0.35 // Must match OCCLUSION_FLOOR in base.frag
+#define LIGHT_FALLOFF 0.8 // Intensity kept by each light level from the one above, must match base.frag
+#define BLOCK_LIGHT_COLOR vec3(1.0, 0.8, 0.55) // Must match base.frag
+
+// Lighting pass of the deferred path, same Phong model as base.frag
+in vec2 ScreenCoord;
+in vec2 TexCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D gNormal;
+uniform usampler2D gMaterial;
+uniform sampler2D gDepth;
+
+uniform mat4 invViewProjection;
+
+struct Material {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float shininess;
+    bool flow;
+};
+
+struct Light {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec4 positionRadius; // xyz position, w radius
+    vec4 color;
+};
+
+uniform Light light;
+
+// Shared by every program, filled by ShaderData::setupMaterials
+layout (std140) uniform Materials {
+    Material materials[NUM_MATERIALS];
+};
+
+// Written once per frame by FrameUniforms
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float time;
+    vec3 lightPosition;
+};
+
+// Filled by DeferredRenderer::addLight
+layout (std140) uniform Lights {
+    int lightCount;
+    PointLight lights[MAX_POINT_LIGHTS];
+};
+
+// Filled by ShadowCascades
+uniform sampler2DArrayShadow shadowMap;
+layout (std140) uniform Shadows {
+    mat4 shadowMatrices[SHADOW_CASCADES];
+    vec4 cascadeSplits; // Distance from the camera covered by each cascade, 0 when disabled
+    vec4 cascadeTexelSizes;
+};
+
+// 1.0 when lit by the sun, 0.0 in its shadow
+float sunShadow(vec3 position, vec3 normal)
+{
+    float cameraDistance = length(viewPos - position);
+    for (int i = 0; i < SHADOW_CASCADES; i++) {
+        if (cameraDistance < cascadeSplits[i]) {
+            // Push the position along the normal to avoid shadow acne
+            vec4 coord = shadowMatrices[i] * vec4(position + normal * cascadeTexelSizes[i] * 1.5, 1.0);
+            return texture(shadowMap, vec4(coord.xy, float(i), coord.z));
+        }
+    }
+    return 1.0;
+}
+
+// Light level from 0 to 1 to an intensity, each level is about LIGHT_FALLOFF times dimmer than the next one
+// and level 0 is dark
+float lightIntensity(float level)
+{
+    return level * pow(LIGHT_FALLOFF, (1.0 - level) * 15.0);
+}
+
+void main()
+{
+    float depth = texture(gDepth, TexCoord).r;
+    if (depth == 1.0)
+        discard; // Sky
+
+    // Back from the depth buffer to world space
+    vec4 position = invViewProjection * vec4(vec3(ScreenCoord, depth) * 2.0 - 1.0, 1.0);
+    vec3 FragPos = position.xyz / position.w;
+
+    uvec4 materialShading = texture(gMaterial, TexCoord);
+    Material currentMaterial = materials[materialShading.r];
+    vec3 shading = vec3(materialShading.gba) / 255.0; // Ambient occlusion, sky and block light
+    float occlusion = mix(OCCLUSION_FLOOR, 1.0, shading.x);
+    float skyLight = lightIntensity(shading.y);
+    vec3 norm = normalize(texture(gNormal, TexCoord).rgb * 2.0 - 1.0);
+    vec3 viewDir = normalize(viewPos - FragPos);
+
+    // ambient
+    vec3 ambient = light.ambient * currentMaterial.ambient * occlusion * skyLight;
+
+    // diffuse
+    vec3 lightDir = normalize(lightPosition - FragPos);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * (diff * currentMaterial.diffuse);
+
+    // specular
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), currentMaterial.shininess);
+    vec3 specular = light.specular * (spec * currentMaterial.specular);
+
+    float shadow = skyLight * sunShadow(FragPos, norm);
+    diffuse *= shadow;
+    specular *= shadow;
+
+    // point lights, fading out to zero at their radius
+    for (int i = 0; i < lightCount; i++) {
+        vec3 toLight = lights[i].positionRadius.xyz - FragPos;
+        float lightDistance = length(toLight);
+        float radius = lights[i].positionRadius.w;
+        if (lightDistance >= radius)
+            continue;
+        float attenuation = 1.0 - lightDistance / radius;
+        attenuation *= attenuation;
+
+        vec3 pointDir = toLight / lightDistance;
+        float pointDiff = max(dot(norm, pointDir), 0.0);
+        float pointSpec = pow(max(dot(viewDir, reflect(-pointDir, norm)), 0.0), currentMaterial.shininess);
+        diffuse += lights[i].color.rgb * (attenuation * pointDiff * currentMaterial.diffuse);
+        specular += lights[i].color.rgb * (attenuation * pointSpec * currentMaterial.specular);
+    }
+
+    // block light, from the emitting voxels nearby
+    vec3 block = BLOCK_LIGHT_COLOR * currentMaterial.diffuse * occlusion * lightIntensity(shading.z);
+
+    vec3 result = ambient + block + diffuse + specular;
+    FragColor = vec4(result, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#version 330 core
+// Full-screen triangle, no vertex buffer
+
+out vec2 ScreenCoord; // In [0, 1] over the frame
+out vec2 TexCoord; // In the G-buffer, which can be larger than the frame
+
+uniform vec2 uvScale;
+
+void main()
+{
+    ScreenCoord = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    TexCoord = ScreenCoord * uvScale;
+    gl_Position = vec4(ScreenCoord * 2.0 - 1.0, 0.0, 1.0);
+}
\ No newline at end of file
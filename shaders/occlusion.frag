@@ -0,0 +1,9 @@
+#version 330 core
+
+// Only the depth test matters, the color writes are masked
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = vec4(1.0);
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) in vec3 aPos; // Corner of the unit cube
+
+uniform vec3 boxMin;
+uniform vec3 boxMax;
+
+// Written once per frame by FrameUniforms
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float time;
+    vec3 lightPosition;
+};
+
+void main()
+{
+    gl_Position = projection * view * vec4(mix(boxMin, boxMax, aPos), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#version 330 core
+// Vertex pulling: there are no vertex attributes, each face is a record of three texels of the `faces` texture buffer
+// gl_VertexID / 6 is the face and gl_VertexID % 6 the vertex
+// Record layout (see packFace, packOcclusion and packBlockLight in chunk.cpp):
+// 0: x, y and z on 6 bits each, side index on 3 bits, material on 8 bits
+// 1: ambient occlusion of the 4 corners on 2 bits each, then their sky light on 4 bits each
+// 2: block light of the 4 corners on 4 bits each
+
+uniform usamplerBuffer faces;
+
+flat out int material; // Output a color index to the fragment shader
+flat out vec3 normalRaw; // Output a normal to the fragment shader
+out float ambientOcclusion; // 0 in a fully occluded corner, 1 in the open
+out vec2 voxelLight; // Sky and block light levels, from 0 to 1
+out vec3 FragPos; // Output a position to the fragment shader
+
+// Also used by the depth pre-pass, which must compute the exact same depth
+invariant gl_Position;
+
+uniform mat4 model;
+
+// Written once per frame by FrameUniforms
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float time;
+    vec3 lightPosition;
+};
+
+// Same corners as CubeMeshSides::corners, counter-clockwise seen from outside
+const vec3 corners[24] = vec3[24](
+    vec3(-0.5, -0.5, 0.5), vec3(0.5, -0.5, 0.5), vec3(0.5, 0.5, 0.5), vec3(-0.5, 0.5, 0.5), // front
+    vec3(0.5, -0.5, -0.5), vec3(-0.5, -0.5, -0.5), vec3(-0.5, 0.5, -0.5), vec3(0.5, 0.5, -0.5), // back
+    vec3(-0.5, -0.5, -0.5), vec3(-0.5, -0.5, 0.5), vec3(-0.5, 0.5, 0.5), vec3(-0.5, 0.5, -0.5), // left
+    vec3(0.5, -0.5, 0.5), vec3(0.5, -0.5, -0.5), vec3(0.5, 0.5, -0.5), vec3(0.5, 0.5, 0.5), // right
+    vec3(-0.5, 0.5, 0.5), vec3(0.5, 0.5, 0.5), vec3(0.5, 0.5, -0.5), vec3(-0.5, 0.5, -0.5), // top
+    vec3(-0.5, -0.5, -0.5), vec3(0.5, -0.5, -0.5), vec3(0.5, -0.5, 0.5), vec3(-0.5, -0.5, 0.5) // bottom
+);
+
+// Same as CubeMeshSides::quad_triangles, the second row splits the quad along the other diagonal
+const int triangles[12] = int[12](
+    0, 1, 2, 2, 3, 0,
+    1, 2, 3, 3, 0, 1
+);
+
+// Same normals as CubeMeshSides::faces_array_normals
+const vec3 normals[6] = vec3[6](
+    vec3(0.0, 0.0, 1.0), // front
+    vec3(0.0, 0.0, -1.0), // back
+    vec3(-1.0, 0.0, 0.0), // left
+    vec3(1.0, 0.0, 0.0), // right
+    vec3(0.0, 1.0, 0.0), // top
+    vec3(0.0, -1.0, 0.0) // bottom
+);
+
+void main()
+{
+    int face = gl_VertexID / 6 * 3;
+    uint record = texelFetch(faces, face).r;
+    uint shading = texelFetch(faces, face + 1).r;
+    uint blockLight = texelFetch(faces, face + 2).r;
+    vec3 voxel = vec3(record & 63u, (record >> 6) & 63u, (record >> 12) & 63u);
+    int side = int((record >> 18) & 7u);
+
+    // Same choice of diagonal as flipQuad in chunk.cpp
+    uvec4 occlusion = (uvec4(shading) >> uvec4(0u, 2u, 4u, 6u)) & 3u;
+    int flip = occlusion.x + occlusion.z < occlusion.y + occlusion.w ? 6 : 0;
+    int corner = triangles[flip + gl_VertexID % 6];
+
+    material = int((record >> 21) & 255u);
+    normalRaw = normals[side];
+    ambientOcclusion = float(occlusion[corner]) / 3.0;
+    uint shift = uint(corner) * 4u;
+    voxelLight = vec2((shading >> (8u + shift)) & 15u, (blockLight >> shift) & 15u) / 15.0;
+    vec3 aPos = voxel + corners[side * 4 + corner];
+    FragPos = vec3(model * vec4(aPos, 1.0));
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include "testgl/bricks.hpp"
+
+#include <cstring>
+
+template <typename Cell>
+uint16_t BrickGrid<Cell>::allocate(Cell value)
+{
+    uint16_t slot;
+    if (!freeSlots.empty())
+    {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else
+    {
+        slot = pool.size() / BRICK_VOXELS;
+        pool.resize(pool.size() + BRICK_VOXELS);
+    }
+    memset(&pool[slot * BRICK_VOXELS], value, BRICK_VOXELS);
+    return slot;
+}
+
+template <typename Cell>
+void BrickGrid<Cell>::collapseBrick(uint16_t &entry)
+{
+    if (entry & UNIFORM_BRICK)
+        return;
+    const Cell *brick = &pool[entry * BRICK_VOXELS];
+    for (int i = 1; i < BRICK_VOXELS; i++)
+    {
+        if (brick[i] != brick[0])
+            return;
+    }
+    freeSlots.push_back(entry);
+    entry = UNIFORM_BRICK | brick[0];
+}
+
+template <typename Cell>
+void BrickGrid<Cell>::write(int x, int y, int z, Cell value)
+{
+    uint16_t &entry = table[brickIndex(x, y, z)];
+    if (entry & UNIFORM_BRICK)
+    {
+        if ((Cell)(entry & 0xFF) == value)
+            return;
+        entry = allocate((Cell)(entry & 0xFF));
+    }
+    pool[entry * BRICK_VOXELS + localIndex(x, y, z)] = value;
+}
+
+template <typename Cell>
+void BrickGrid<Cell>::set(int x, int y, int z, Cell value)
+{
+    write(x, y, z, value);
+    collapseBrick(table[brickIndex(x, y, z)]);
+}
+
+template <typename Cell>
+void BrickGrid<Cell>::collapse()
+{
+    for (uint16_t &entry : table)
+        collapseBrick(entry);
+}
+
+template <typename Cell>
+void BrickGrid<Cell>::fill(Cell value)
+{
+    table.assign(BRICK_COUNT, UNIFORM_BRICK | value);
+    pool.clear();
+    pool.shrink_to_fit();
+    freeSlots.clear();
+}
+
+template <typename Cell>
+void BrickGrid<Cell>::compress(const Cell *values)
+{
+    fill((Cell)0);
+
+    Cell brick[BRICK_VOXELS];
+    for (int bz = 0; bz < BRICKS_PER_SIDE; bz++)
+    {
+        for (int by = 0; by < BRICKS_PER_SIDE; by++)
+        {
+            for (int bx = 0; bx < BRICKS_PER_SIDE; bx++)
+            {
+                // Gather the brick, one row of BRICK_SIZE voxels at a time
+                bool uniform = true;
+                for (int z = 0; z < BRICK_SIZE; z++)
+                {
+                    for (int y = 0; y < BRICK_SIZE; y++)
+                    {
+                        const Cell *row = &values[bx * BRICK_SIZE + CHUNK_SIZE * (by * BRICK_SIZE + y + CHUNK_SIZE * (bz * BRICK_SIZE + z))];
+                        Cell *destination = &brick[BRICK_SIZE * (y + BRICK_SIZE * z)];
+                        memcpy(destination, row, BRICK_SIZE);
+                        for (int x = 0; x < BRICK_SIZE; x++)
+                            uniform = uniform && destination[x] == brick[0];
+                    }
+                }
+
+                uint16_t &entry = table[bx + BRICKS_PER_SIDE * (by + BRICKS_PER_SIDE * bz)];
+                if (uniform)
+                {
+                    entry = UNIFORM_BRICK | brick[0];
+                    continue;
+                }
+                entry = pool.size() / BRICK_VOXELS;
+                pool.insert(pool.end(), brick, brick + BRICK_VOXELS);
+            }
+        }
+    }
+    // The pool grew by doubling, keep only what the chunk needs
+    pool.shrink_to_fit();
+}
+
+template <typename Cell>
+void BrickGrid<Cell>::expand(Cell *values)
+{
+    for (int bz = 0; bz < BRICKS_PER_SIDE; bz++)
+    {
+        for (int by = 0; by < BRICKS_PER_SIDE; by++)
+        {
+            for (int bx = 0; bx < BRICKS_PER_SIDE; bx++)
+            {
+                uint16_t entry = table[bx + BRICKS_PER_SIDE * (by + BRICKS_PER_SIDE * bz)];
+                for (int z = 0; z < BRICK_SIZE; z++)
+                {
+                    for (int y = 0; y < BRICK_SIZE; y++)
+                    {
+                        Cell *row = &values[bx * BRICK_SIZE + CHUNK_SIZE * (by * BRICK_SIZE + y + CHUNK_SIZE * (bz * BRICK_SIZE + z))];
+                        if (entry & UNIFORM_BRICK)
+                            memset(row, entry & 0xFF, BRICK_SIZE);
+                        else
+                            memcpy(row, &pool[entry * BRICK_VOXELS + BRICK_SIZE * (y + BRICK_SIZE * z)], BRICK_SIZE);
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <typename Cell>
+void BrickGrid<Cell>::clear()
+{
+    table.clear();
+    table.shrink_to_fit();
+    pool.clear();
+    pool.shrink_to_fit();
+    freeSlots.clear();
+    freeSlots.shrink_to_fit();
+}
+
+template <typename Cell>
+size_t BrickGrid<Cell>::getBytes()
+{
+    return table.capacity() * sizeof(uint16_t) + pool.capacity() * sizeof(Cell) + freeSlots.capacity() * sizeof(uint16_t);
+}
+
+template class BrickGrid<Voxel>;
+template class BrickGrid<uint8_t>;
@@ -1,6 +1,15 @@
 #include "testgl/player.hpp"
 #include "testgl/callbacks.hpp"
 #include "testgl/logging.hpp"
+#include "testgl/profiler.hpp"
+#include "testgl/occlusion.hpp"
+#include "testgl/world.hpp"
+#include "testgl/deferred.hpp"
+#include "testgl/shadows.hpp"
+#include "testgl/resolution.hpp"
+#include "testgl/window.hpp"
+#include "testgl/pacing.hpp"
+#include "testgl/farterrain.hpp"
 
 // glfw error callback
 void glfw_error_callback(int error, const char *description)
@@ -8,10 +17,14 @@ void glfw_error_callback(int error, const char *description)
     log_error("GLFW Error (%d): %s", error, description);
 }
 
-void glfw_window_size_callback(GLFWwindow *window, int width, int height)
+void glfw_framebuffer_size_callback(GLFWwindow *window, int width, int height)
 {
-    log_debug("Window resized to %dx%d", width, height);
+    // In pixels, bigger than the window on high DPI screens
+    log_debug("Framebuffer resized to %dx%d", width, height);
+    Window::framebufferWidth = width;
+    Window::framebufferHeight = height;
     glViewport(0, 0, width, height);
+    // The render targets follow in the main loop
 }
 
 void setup_player_callbacks(GLFWwindow *window, Player *player)
@@ -128,6 +141,20 @@ void glfw_key_callback(GLFWwindow *window, int key, int scancode, int action, in
         glfwSetWindowShouldClose(window, GLFW_TRUE);
     }
 
+    // Pressed F1
+    if (key == GLFW_KEY_F1 && action == GLFW_PRESS)
+    {
+        FarTerrain::enabled = !FarTerrain::enabled;
+        log_debug("F1 key pressed, far terrain %s", FarTerrain::enabled ? "enabled" : "disabled");
+    }
+
+    // Pressed F2
+    if (key == GLFW_KEY_F2 && action == GLFW_PRESS)
+    {
+        log_debug("F2 key pressed, changing frame pacing");
+        FramePacer::cycleMode();
+    }
+
     // Pressed F3
     if (key == GLFW_KEY_F3 && action == GLFW_PRESS)
     {
@@ -135,6 +162,70 @@ void glfw_key_callback(GLFWwindow *window, int key, int scancode, int action, in
         Player *player = get_player(window);
         player->toggle_debug();
     }
+
+    // Pressed F4
+    if (key == GLFW_KEY_F4 && action == GLFW_PRESS)
+    {
+        log_debug("F4 key pressed, toggling profiler overlay");
+        profiler::toggle();
+    }
+
+    // Pressed F5
+    if (key == GLFW_KEY_F5 && action == GLFW_PRESS)
+    {
+        log_debug("F5 key pressed, toggling trace capture");
+        profiler::toggleTrace();
+    }
+
+    // Pressed F6
+    if (key == GLFW_KEY_F6 && action == GLFW_PRESS)
+    {
+        OcclusionCuller::enabled = !OcclusionCuller::enabled;
+        log_debug("F6 key pressed, occlusion culling %s", OcclusionCuller::enabled ? "enabled" : "disabled");
+    }
+
+    // Pressed F7
+    if (key == GLFW_KEY_F7 && action == GLFW_PRESS)
+    {
+        World::visibilityCulling = !World::visibilityCulling;
+        log_debug("F7 key pressed, visibility culling %s", World::visibilityCulling ? "enabled" : "disabled");
+    }
+
+    // Pressed F8
+    if (key == GLFW_KEY_F8 && action == GLFW_PRESS)
+    {
+        DepthPrepass::enabled = !DepthPrepass::enabled;
+        log_debug("F8 key pressed, depth pre-pass %s", DepthPrepass::enabled ? "enabled" : "disabled");
+    }
+
+    // Pressed F9
+    if (key == GLFW_KEY_F9 && action == GLFW_PRESS)
+    {
+        Chunk::vertexPulling = !Chunk::vertexPulling;
+        World::remeshRequested = true;
+        log_debug("F9 key pressed, vertex pulling %s", Chunk::vertexPulling ? "enabled" : "disabled");
+    }
+
+    // Pressed F10
+    if (key == GLFW_KEY_F10 && action == GLFW_PRESS)
+    {
+        DeferredRenderer::enabled = !DeferredRenderer::enabled;
+        log_debug("F10 key pressed, deferred shading %s", DeferredRenderer::enabled ? "enabled" : "disabled");
+    }
+
+    // Pressed F11
+    if (key == GLFW_KEY_F11 && action == GLFW_PRESS)
+    {
+        ShadowCascades::enabled = !ShadowCascades::enabled;
+        log_debug("F11 key pressed, shadows %s", ShadowCascades::enabled ? "enabled" : "disabled");
+    }
+
+    // Pressed F12
+    if (key == GLFW_KEY_F12 && action == GLFW_PRESS)
+    {
+        DynamicResolution::enabled = !DynamicResolution::enabled;
+        log_debug("F12 key pressed, dynamic resolution %s", DynamicResolution::enabled ? "enabled" : "disabled");
+    }
 }
 
 // glfw mouse button callback
@@ -7,18 +7,79 @@
 #include "testgl/world.hpp"
 
 #include <cstring>
+#include <algorithm>
 
 #define voxel3d(x, y, z) (voxels[(x) + CHUNK_SIZE * ((y) + CHUNK_SIZE * (z))])
-#define _getVoxel(x, y, z) (isSimpleChunk ? simpleChunkVoxel : voxel3d(x, y, z))
+#define _getVoxel(x, y, z) (isSimpleChunk ? simpleChunkVoxel : voxels ? voxel3d(x, y, z) : bricks.get(x, y, z))
 
-Chunk::Chunk(int x, int y, int z, World *world) : VAO(0), VBO(0), EBO(0),
+#define ALL_CONNECTED 0x7FFF // All the 15 pairs of faces
+
+// Bytes per vertex of the expanded mesh: 3 floats coords, 1 int color and 3 floats normals
+#define VERTEX_BYTES (3 * sizeof(float) + sizeof(int) + 3 * sizeof(float))
+
+std::atomic<bool> Chunk::vertexPulling(VERTEX_PULLING);
+bool Chunk::brickStorage = BRICK_STORAGE;
+int Chunk::drawCalls = 0;
+
+// Face records read by pulled.vert are three words, packFace, packOcclusion then packBlockLight
+#define FACE_WORDS 3
+#define FACE_BYTES (FACE_WORDS * sizeof(uint32_t))
+
+// First word of a face record: x, y and z on 6 bits each, the side index on 3 bits and the material on 8 bits
+static_assert(CHUNK_SIZE <= 64, "Face records store voxel coordinates on 6 bits");
+static inline uint32_t packFace(int x, int y, int z, int side, Voxel material)
+{
+    return x | y << 6 | z << 12 | side << 18 | (uint32_t)material << 21;
+}
+
+// Second word of a face record: the occlusion of each corner on 2 bits then their sky light on 4 bits,
+// in CubeMeshSides::corners order
+static inline uint32_t packOcclusion(const int occlusion[4], const int skyLight[4])
+{
+    return occlusion[0] | occlusion[1] << 2 | occlusion[2] << 4 | occlusion[3] << 6 |
+           skyLight[0] << 8 | skyLight[1] << 12 | skyLight[2] << 16 | skyLight[3] << 20;
+}
+
+// Third word of a face record: the block light of each corner on 4 bits
+static inline uint32_t packBlockLight(const int blockLight[4])
+{
+    return blockLight[0] | blockLight[1] << 4 | blockLight[2] << 8 | blockLight[3] << 12;
+}
+
+// Color of an expanded vertex: the material, then the occlusion on 2 bits, the sky and the block light on 4 bits
+// Must match base.vert
+static inline int packVertexColor(Voxel material, int occlusion, int skyLight, int blockLight)
+{
+    return material | occlusion << 8 | skyLight << 10 | blockLight << 14;
+}
+
+static inline int lightLevel(uint8_t packed, LightChannel channel)
+{
+    return channel == LightChannel::SkyLight ? packed >> 4 : packed & 15;
+}
+
+static inline uint8_t withLightLevel(uint8_t packed, LightChannel channel, int level)
+{
+    return channel == LightChannel::SkyLight ? (packed & 15) | level << 4 : (packed & 0xF0) | level;
+}
+
+// Split the quad along its brighter diagonal, otherwise the interpolated occlusion depends on the orientation of the face
+// Must match pulled.vert
+static inline bool flipQuad(const int occlusion[4])
+{
+    return occlusion[0] + occlusion[2] < occlusion[1] + occlusion[3];
+}
+
+Chunk::Chunk(int x, int y, int z, World *world) : voxels(nullptr),
+                                                  uniformLight(0),
+                                                  readyMesh(nullptr), uploadingMesh(nullptr),
+                                                  drawPulled(false),
+                                                  VAO(0), VBO(0), EBO(0), faceTexture(0), drawSize(0),
+                                                  uploadVBO(0), uploadOffset(0),
+                                                  occlusionQueries{0, 0}, occlusionQueryFrames{-1, -1},
                                                   world(world),
-                                                  needsDraw({{{0}}}),
-                                                  voxels({(Voxel)0}),
-                                                  obstructions({{{false}}}),
-                                                  meshVertices(nullptr),
-                                                  meshColors(nullptr),
-                                                  meshNormals(nullptr)
+                                                  handle({0, 0}),
+                                                  obstructions({{{false}}})
 {
     m_x = x;
     m_y = y;
@@ -35,22 +96,25 @@ Chunk::Chunk(int x, int y, int z, World *world) : VAO(0), VBO(0), EBO(0),
     // m_invModelMatrix = glm::inverse(m_modelMatrix);
     m_invModelMatrix = glm::translate(glm::mat4(1.0f), -glm::vec3(x, y, z) * (float)CHUNK_SIZE); // We only translate, so the inverse is the opposite translation
 
-    meshSize = 0;
+    drawBoundsMin = drawBoundsMax = glm::vec3(0.0f);
+    for (int f = 0; f < 6; f++)
+        drawSideFirst[f] = drawSideCount[f] = 0;
 
     isSimpleChunk = true;
     simpleChunkVoxel = Voxel::Air;
 
     edgeChanged = Side::NONE;
+
+    // Until it is computed, assume we can see through the chunk
+    connectivity = ALL_CONNECTED;
 }
 
 Chunk::~Chunk()
 {
-    if (meshVertices)
-        delete[] meshVertices;
-    if (meshColors)
-        delete[] meshColors;
-    if (meshNormals)
-        delete[] meshNormals;
+    if (voxels)
+        delete[] voxels;
+    delete readyMesh;
+    delete uploadingMesh;
 
     // log_debug("Discarding chunk (%d, %d, %d)", m_x, m_y, m_z);
 }
@@ -60,6 +124,64 @@ Voxel Chunk::getVoxel(int x, int y, int z)
     return _getVoxel(x, y, z);
 }
 
+int Chunk::getAirCell(int x, int y, int z)
+{
+    if (isSimpleChunk)
+        return simpleChunkVoxel == Voxel::Air ? CHUNK_SIZE : 0;
+    if (voxels)
+        return voxel3d(x, y, z) == Voxel::Air ? 1 : 0;
+    Voxel uniform;
+    if (bricks.isUniform(BrickStorage::brickIndex(x, y, z), &uniform))
+        return uniform == Voxel::Air ? BRICK_SIZE : 0;
+    return bricks.get(x, y, z) == Voxel::Air ? 1 : 0;
+}
+
+// Generation target and expanded bricks, one per thread since the chunks are lit in parallel
+static Voxel *scratchVoxels()
+{
+    thread_local std::vector<Voxel> scratch(CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE);
+    return scratch.data();
+}
+
+void Chunk::storeVoxel(int x, int y, int z, Voxel value)
+{
+    if (voxels)
+        voxel3d(x, y, z) = value;
+    else
+        bricks.set(x, y, z, value);
+}
+
+void Chunk::allocateVoxels(Voxel voxel)
+{
+    if (brickStorage)
+        bricks.fill(voxel);
+    else
+    {
+        voxels = new Voxel[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];
+        memset(voxels, voxel, CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE);
+    }
+}
+
+void Chunk::allocateVoxels(const Voxel *source)
+{
+    if (brickStorage)
+        bricks.compress(source);
+    else
+    {
+        voxels = new Voxel[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];
+        memcpy(voxels, source, CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE);
+    }
+}
+
+const Voxel *Chunk::flatVoxels()
+{
+    if (voxels)
+        return voxels;
+    Voxel *expanded = scratchVoxels();
+    bricks.expand(expanded);
+    return expanded;
+}
+
 void Chunk::setVoxel(int x, int y, int z, Voxel value)
 {
     if (x < 0 || x >= CHUNK_SIZE || y < 0 || y >= CHUNK_SIZE || z < 0 || z >= CHUNK_SIZE)
@@ -75,26 +197,18 @@ void Chunk::setVoxel(int x, int y, int z, Voxel value)
         else
         {
             isSimpleChunk = false;
-            for (int i = 0; i < CHUNK_SIZE; i++)
-            {
-                for (int j = 0; j < CHUNK_SIZE; j++)
-                {
-                    for (int k = 0; k < CHUNK_SIZE; k++)
-                    {
-                        voxel3d(i, j, k) = simpleChunkVoxel;
-                    }
-                }
-            }
+            allocateVoxels(simpleChunkVoxel);
             needsMeshUpdate = true;
             world->addToMeshQueue(this);
         }
     }
     // Check if the voxel is actually changing
-    if (voxel3d(x, y, z) == value)
+    Voxel previous = _getVoxel(x, y, z);
+    if (previous == value)
         return;
 
     // Check if the voxel is on the edge of the chunk if the mesh shape changes
-    if (value == Voxel::Air != voxel3d(x, y, z) == Voxel::Air) // XOR
+    if (value == Voxel::Air != previous == Voxel::Air) // XOR
     {
         if (x == 0)
             edgeChanged |= Side::LEFT;
@@ -120,16 +234,127 @@ void Chunk::setVoxel(int x, int y, int z, Voxel value)
         world->addToMeshQueue(this);
     }
 
-    voxel3d(x, y, z) = value;
+    storeVoxel(x, y, z, value);
 }
 
 void Chunk::populate(WorldGenerator::function_t worldGenerator)
 {
-    worldGenerator(getPos(), voxels, &simpleChunkVoxel, &isSimpleChunk);
+    // The generators only write the voxels that are not air, and nothing at all for a simple chunk
+    Voxel *generated = scratchVoxels();
+    memset(generated, Voxel::Air, CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE);
+    worldGenerator(getPos(), generated, &simpleChunkVoxel, &isSimpleChunk);
+    if (!isSimpleChunk)
+        allocateVoxels(generated);
     needsSideOcclusionUpdate = true; // we now need to calculate which sides are worth drawing
     world->addToFaceOcclusionQueue(this);
 }
 
+void Chunk::calculateLight()
+{
+    if (isSimpleChunk)
+    {
+        uniformLight = (simpleChunkVoxel == Voxel::Air ? MAX_LIGHT_LEVEL << 4 : 0) | voxelEmission(simpleChunkVoxel);
+        light.clear();
+        return;
+    }
+    // Flooded in a dense array, then compressed into bricks
+    thread_local std::vector<uint8_t> scratchLight(CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE);
+    uint8_t *light = scratchLight.data();
+    memset(light, 0, CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE);
+    // Shadows the member, voxel3d then reads the flat copy
+    const Voxel *voxels = flatVoxels();
+
+    thread_local std::vector<int> queue;
+    for (LightChannel channel : {LightChannel::SkyLight, LightChannel::BlockLight})
+    {
+        queue.clear();
+        if (channel == LightChannel::SkyLight)
+        {
+            // The sky light falls through each column until it hits a voxel
+            for (int x = 0; x < CHUNK_SIZE; x++)
+                for (int z = 0; z < CHUNK_SIZE; z++)
+                    for (int y = CHUNK_SIZE - 1; y >= 0 && voxel3d(x, y, z) == Voxel::Air; y--)
+                    {
+                        light[x + CHUNK_SIZE * (y + CHUNK_SIZE * z)] = MAX_LIGHT_LEVEL << 4;
+                        queue.push_back(x + CHUNK_SIZE * (y + CHUNK_SIZE * z));
+                    }
+        }
+        else
+        {
+            for (int index = 0; index < CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE; index++)
+            {
+                int emission = voxelEmission(voxels[index]);
+                if (emission == 0)
+                    continue;
+                light[index] = withLightLevel(light[index], channel, emission);
+                queue.push_back(index);
+            }
+        }
+
+        // Breadth first flood fill, each step loses one level
+        for (size_t head = 0; head < queue.size(); head++)
+        {
+            int index = queue[head];
+            int x = index % CHUNK_SIZE;
+            int y = index / CHUNK_SIZE % CHUNK_SIZE;
+            int z = index / (CHUNK_SIZE * CHUNK_SIZE);
+            int level = lightLevel(light[index], channel);
+
+            // Neighbors inside the chunk, as offsets in the light array
+            const int neighbors[6][2] = {
+                {x > 0, -1},
+                {x < CHUNK_SIZE - 1, 1},
+                {y > 0, -CHUNK_SIZE},
+                {y < CHUNK_SIZE - 1, CHUNK_SIZE},
+                {z > 0, -CHUNK_SIZE * CHUNK_SIZE},
+                {z < CHUNK_SIZE - 1, CHUNK_SIZE * CHUNK_SIZE},
+            };
+            for (auto &[inside, offset] : neighbors)
+            {
+                int next = index + offset;
+                if (!inside || voxels[next] != Voxel::Air)
+                    continue;
+                // The columns already hold the light falling straight down
+                int nextLevel = level - 1;
+                if (nextLevel > lightLevel(light[next], channel))
+                {
+                    light[next] = withLightLevel(light[next], channel, nextLevel);
+                    queue.push_back(next);
+                }
+            }
+        }
+    }
+    this->light.compress(light);
+
+    // Nothing to keep in bricks for a chunk buried in the dark
+    uint8_t first = light[0];
+    for (int brick = 0; brick < BRICK_COUNT; brick++)
+    {
+        uint8_t level;
+        if (!this->light.isUniform(brick, &level) || level != first)
+            return;
+    }
+    uniformLight = first;
+    this->light.clear();
+}
+
+int Chunk::getLight(int x, int y, int z, LightChannel channel)
+{
+    return lightLevel(light.isUsed() ? light.get(x, y, z) : uniformLight, channel);
+}
+
+void Chunk::setLight(int x, int y, int z, LightChannel channel, int level)
+{
+    if (!light.isUsed())
+    {
+        uint8_t value = withLightLevel(uniformLight, channel, level);
+        if (value == uniformLight)
+            return;
+        light.fill(uniformLight);
+    }
+    light.set(x, y, z, withLightLevel(light.get(x, y, z), channel, level));
+}
+
 void Chunk::setVoxelLayer(int y, Voxel value)
 {
     if (y < 0 || y >= CHUNK_SIZE)
@@ -152,7 +377,7 @@ void Chunk::setVoxelLayer(int y, Voxel value)
     {
         for (int j = 0; j < CHUNK_SIZE; j++)
         {
-            voxel3d(i, y, j) = value;
+            storeVoxel(i, y, j, value);
         }
     }
     needsSideOcclusionUpdate = true;
@@ -164,27 +389,215 @@ void Chunk::setVoxelLayer(int y, Voxel value)
         edgeChanged |= Side::TOP;
 }
 
-void Chunk::calculateNeedsDraw()
+// Sides of the chunk a voxel touches
+static Sides borderSides(int x, int y, int z)
 {
-    needsSideOcclusionUpdate = false;
-    needsMeshUpdate = false;
-    needsDrawCount = 0;
+    Sides sides = Side::NONE;
+    if (x == 0)
+        sides |= Side::LEFT;
+    else if (x == CHUNK_SIZE - 1)
+        sides |= Side::RIGHT;
+    if (y == 0)
+        sides |= Side::BOTTOM;
+    else if (y == CHUNK_SIZE - 1)
+        sides |= Side::TOP;
+    if (z == 0)
+        sides |= Side::BACK;
+    else if (z == CHUNK_SIZE - 1)
+        sides |= Side::FRONT;
+    return sides;
+}
 
-    for (int i = 0; i < CHUNK_SIZE; i++)
+void Chunk::writeRegion(const VoxelRegion &region, glm::ivec3 origin, const Voxel *fill, std::vector<VoxelChange> &changes)
+{
+    // Part of the region inside the chunk, the upper bound is excluded
+    glm::ivec3 first = glm::max(origin, glm::ivec3(0));
+    glm::ivec3 last = glm::min(origin + region.getSize(), glm::ivec3(CHUNK_SIZE));
+    if (first.x >= last.x || first.y >= last.y || first.z >= last.z)
+        return;
+
+    bool uniform = fill != nullptr || region.isUniform();
+    Voxel uniformVoxel = fill != nullptr ? *fill : region.getFillVoxel();
+    if (isSimpleChunk && uniform && uniformVoxel == simpleChunkVoxel)
+        return;
+
+    glm::ivec3 chunkOrigin = glm::ivec3(m_x, m_y, m_z) * CHUNK_SIZE;
+    size_t firstChange = changes.size();
+    bool wholeChunk = uniform && !region.isMasked() && first == glm::ivec3(0) && last == glm::ivec3(CHUNK_SIZE);
+
+    for (int z = first.z; z < last.z; z++)
     {
-        for (int j = 0; j < CHUNK_SIZE; j++)
+        for (int y = first.y; y < last.y; y++)
+        {
+            const Voxel *row = uniform ? nullptr : region.getRow(y - origin.y, z - origin.z) + (first.x - origin.x);
+            const uint8_t *mask = region.getMaskRow(y - origin.y, z - origin.z);
+            if (mask != nullptr)
+                mask += first.x - origin.x;
+
+            // Compare first, only the replaced voxels are relit
+            size_t rowChanges = changes.size();
+            for (int x = first.x; x < last.x; x++)
+            {
+                int i = x - first.x;
+                if (mask != nullptr && !mask[i])
+                    continue;
+                Voxel value = row != nullptr ? row[i] : uniformVoxel;
+                Voxel before = _getVoxel(x, y, z);
+                if (before == value)
+                    continue;
+                changes.push_back({chunkOrigin.x + x, chunkOrigin.y + y, chunkOrigin.z + z, before});
+                // A simple chunk only gets a storage once a voxel actually changes
+                if (isSimpleChunk && !wholeChunk)
+                {
+                    isSimpleChunk = false;
+                    allocateVoxels(simpleChunkVoxel);
+                }
+                if (!voxels && !isSimpleChunk)
+                    bricks.write(x, y, z, value);
+            }
+
+            // Dense rows are written as whole spans
+            if (!voxels || changes.size() == rowChanges)
+                continue;
+            Voxel *destination = &voxel3d(first.x, y, z);
+            if (mask != nullptr)
+            {
+                for (int i = 0; i < last.x - first.x; i++)
+                    destination[i] = mask[i] ? (row != nullptr ? row[i] : uniformVoxel) : destination[i];
+            }
+            else if (row != nullptr)
+                memcpy(destination, row, last.x - first.x);
+            else
+                memset(destination, uniformVoxel, last.x - first.x);
+        }
+    }
+
+    if (wholeChunk)
+    {
+        // A single voxel again, the storage is released
+        if (voxels)
+            delete[] voxels;
+        voxels = nullptr;
+        bricks.clear();
+        isSimpleChunk = true;
+        simpleChunkVoxel = uniformVoxel;
+    }
+    else if (!voxels && !isSimpleChunk)
+        bricks.collapse();
+
+    if (changes.size() == firstChange)
+        return;
+
+    // One notification for the whole edit, the edges where the shape changed update the neighbors
+    bool shapeChanged = false;
+    for (size_t c = firstChange; c < changes.size(); c++)
+    {
+        glm::ivec3 local = glm::ivec3(changes[c].x, changes[c].y, changes[c].z) - chunkOrigin;
+        if ((changes[c].before == Voxel::Air) == (_getVoxel(local.x, local.y, local.z) == Voxel::Air))
+            continue;
+        shapeChanged = true;
+        edgeChanged |= borderSides(local.x, local.y, local.z);
+    }
+    if (shapeChanged)
+    {
+        needsSideOcclusionUpdate = true;
+        world->addToFaceOcclusionQueue(this);
+    }
+    else
+    {
+        needsMeshUpdate = true;
+        world->addToMeshQueue(this);
+    }
+}
+
+void Chunk::calculateConnectivity()
+{
+    if (isSimpleChunk)
+    {
+        connectivity = simpleChunkVoxel == Voxel::Air ? ALL_CONNECTED : 0;
+        return;
+    }
+
+    // Flood fill each air region and connect all the faces it touches
+    const Voxel *voxels = flatVoxels(); // Shadows the member
+    thread_local std::vector<bool> visited;
+    thread_local std::vector<int> stack;
+    visited.assign(CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE, false);
+
+    uint16_t result = 0;
+    for (int start = 0; start < CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE && result != ALL_CONNECTED; start++)
+    {
+        if (visited[start] || voxels[start] != Voxel::Air)
+            continue;
+
+        Sides faces = Side::NONE;
+        visited[start] = true;
+        stack.push_back(start);
+        while (!stack.empty())
         {
-            for (int k = 0; k < CHUNK_SIZE; k++)
+            int index = stack.back();
+            stack.pop_back();
+            int x = index % CHUNK_SIZE;
+            int y = index / CHUNK_SIZE % CHUNK_SIZE;
+            int z = index / (CHUNK_SIZE * CHUNK_SIZE);
+
+            if (x == 0)
+                faces |= Side::LEFT;
+            if (x == CHUNK_SIZE - 1)
+                faces |= Side::RIGHT;
+            if (y == 0)
+                faces |= Side::BOTTOM;
+            if (y == CHUNK_SIZE - 1)
+                faces |= Side::TOP;
+            if (z == 0)
+                faces |= Side::BACK;
+            if (z == CHUNK_SIZE - 1)
+                faces |= Side::FRONT;
+
+            // Neighbors inside the chunk, as offsets in the voxels array
+            const int neighbors[6][2] = {
+                {x > 0, -1},
+                {x < CHUNK_SIZE - 1, 1},
+                {y > 0, -CHUNK_SIZE},
+                {y < CHUNK_SIZE - 1, CHUNK_SIZE},
+                {z > 0, -CHUNK_SIZE * CHUNK_SIZE},
+                {z < CHUNK_SIZE - 1, CHUNK_SIZE * CHUNK_SIZE},
+            };
+            for (auto &[inside, offset] : neighbors)
             {
-                needsDraw[i][j][k] = Side::NONE;
+                int next = index + offset;
+                if (inside && !visited[next] && voxels[next] == Voxel::Air)
+                {
+                    visited[next] = true;
+                    stack.push_back(next);
+                }
             }
         }
+
+        for (int a = 0; a < 6; a++)
+            for (int b = a + 1; b < 6; b++)
+                if ((faces & (1 << a)) && (faces & (1 << b)))
+                    result |= 1 << side_pair_index(a, b);
     }
+    connectivity = result;
+}
+
+void Chunk::calculateNeedsDraw()
+{
+    needsSideOcclusionUpdate = false;
+    needsMeshUpdate = false;
+    needsDrawCount = 0;
+
+    calculateConnectivity();
+
+    needsDraw.fill(Side::NONE);
+    drawnBricks.reset();
 
     if (isSimpleChunk)
     {
         if (simpleChunkVoxel == Voxel::Air)
         {
+            needsDraw.clear();
             needsMeshUpdate = true;
             world->addToMeshQueue(this);
             return;
@@ -197,37 +610,41 @@ void Chunk::calculateNeedsDraw()
                 {
                     if (!(x == 0 || y == 0 || z == 0 || x == CHUNK_SIZE - 1 || y == CHUNK_SIZE - 1 || z == CHUNK_SIZE - 1))
                         continue; // Don't check the inside of the chunk
+                    drawnBricks.set(BrickStorage::brickIndex(x, y, z));
+                    Sides sides = Side::NONE;
 
                     if (z == CHUNK_SIZE - 1 && !obstructions[0][x][y])
                     {
-                        needsDraw[x][y][z] |= Side::FRONT;
+                        sides |= Side::FRONT;
                         needsDrawCount++;
                     }
                     if (z == 0 && !obstructions[1][x][y])
                     {
-                        needsDraw[x][y][z] |= Side::BACK;
+                        sides |= Side::BACK;
                         needsDrawCount++;
                     }
                     if (x == 0 && !obstructions[2][y][z])
                     {
-                        needsDraw[x][y][z] |= Side::LEFT;
+                        sides |= Side::LEFT;
                         needsDrawCount++;
                     }
                     if (x == CHUNK_SIZE - 1 && !obstructions[3][y][z])
                     {
-                        needsDraw[x][y][z] |= Side::RIGHT;
+                        sides |= Side::RIGHT;
                         needsDrawCount++;
                     }
                     if (y == CHUNK_SIZE - 1 && !obstructions[4][x][z])
                     {
-                        needsDraw[x][y][z] |= Side::TOP;
+                        sides |= Side::TOP;
                         needsDrawCount++;
                     }
                     if (y == 0 && !obstructions[5][x][z])
                     {
-                        needsDraw[x][y][z] |= Side::BOTTOM;
+                        sides |= Side::BOTTOM;
                         needsDrawCount++;
                     }
+                    if (sides != Side::NONE)
+                        needsDraw.write(x, y, z, sides);
                 }
             }
         }
@@ -236,44 +653,85 @@ void Chunk::calculateNeedsDraw()
         return;
     }
 
-    for (int x = 0; x < CHUNK_SIZE; x++)
+    // Brick by brick, so that the empty bricks and the inside of the solid ones are skipped
+    // Only the bricks inside the chunk count, the border is checked voxel by voxel against `obstructions`
+    auto solidBrick = [this](int brickX, int brickY, int brickZ)
+    {
+        Voxel voxel;
+        if (voxels || brickX < 0 || brickY < 0 || brickZ < 0 || brickX >= BRICKS_PER_SIDE || brickY >= BRICKS_PER_SIDE || brickZ >= BRICKS_PER_SIDE)
+            return false;
+        return bricks.isUniform(BrickStorage::brickIndex(brickX * BRICK_SIZE, brickY * BRICK_SIZE, brickZ * BRICK_SIZE), &voxel) && voxel != Voxel::Air;
+    };
+    for (int brickZ = 0; brickZ < BRICKS_PER_SIDE; brickZ++)
     {
-        for (int y = 0; y < CHUNK_SIZE; y++)
+        for (int brickY = 0; brickY < BRICKS_PER_SIDE; brickY++)
         {
-            for (int z = 0; z < CHUNK_SIZE; z++)
+            for (int brickX = 0; brickX < BRICKS_PER_SIDE; brickX++)
             {
-                if (_getVoxel(x, y, z) == Voxel::Air)
+                int brick = BrickStorage::brickIndex(brickX * BRICK_SIZE, brickY * BRICK_SIZE, brickZ * BRICK_SIZE);
+                Voxel uniformVoxel;
+                bool uniform = !voxels && bricks.isUniform(brick, &uniformVoxel);
+                if (uniform && uniformVoxel == Voxel::Air)
+                    continue;
+                // Buried in solid bricks
+                if (uniform && solidBrick(brickX - 1, brickY, brickZ) && solidBrick(brickX + 1, brickY, brickZ) &&
+                    solidBrick(brickX, brickY - 1, brickZ) && solidBrick(brickX, brickY + 1, brickZ) &&
+                    solidBrick(brickX, brickY, brickZ - 1) && solidBrick(brickX, brickY, brickZ + 1))
                     continue;
 
-                if ((z == CHUNK_SIZE - 1 && !obstructions[0][x][y]) || (z != CHUNK_SIZE - 1 && _getVoxel(x, y, z + 1) == Voxel::Air))
-                {
-                    needsDraw[x][y][z] |= Side::FRONT;
-                    needsDrawCount++;
-                }
-                if ((z == 0 && !obstructions[1][x][y]) || (z != 0 && _getVoxel(x, y, z - 1) == Voxel::Air))
-                {
-                    needsDraw[x][y][z] |= Side::BACK;
-                    needsDrawCount++;
-                }
-                if ((x == 0 && !obstructions[2][y][z]) || (x != 0 && _getVoxel(x - 1, y, z) == Voxel::Air))
-                {
-                    needsDraw[x][y][z] |= Side::LEFT;
-                    needsDrawCount++;
-                }
-                if ((x == CHUNK_SIZE - 1 && !obstructions[3][y][z]) || (x != CHUNK_SIZE - 1 && _getVoxel(x + 1, y, z) == Voxel::Air))
-                {
-                    needsDraw[x][y][z] |= Side::RIGHT;
-                    needsDrawCount++;
-                }
-                if ((y == CHUNK_SIZE - 1 && !obstructions[4][x][z]) || (y != CHUNK_SIZE - 1 && _getVoxel(x, y + 1, z) == Voxel::Air))
-                {
-                    needsDraw[x][y][z] |= Side::TOP;
-                    needsDrawCount++;
-                }
-                if ((y == 0 && !obstructions[5][x][z]) || (y != 0 && _getVoxel(x, y - 1, z) == Voxel::Air))
+                for (int x = brickX * BRICK_SIZE; x < (brickX + 1) * BRICK_SIZE; x++)
                 {
-                    needsDraw[x][y][z] |= Side::BOTTOM;
-                    needsDrawCount++;
+                    for (int y = brickY * BRICK_SIZE; y < (brickY + 1) * BRICK_SIZE; y++)
+                    {
+                        for (int z = brickZ * BRICK_SIZE; z < (brickZ + 1) * BRICK_SIZE; z++)
+                        {
+                            // The neighbors of a voxel inside a solid brick are in the same brick
+                            if (uniform && x % BRICK_SIZE != 0 && x % BRICK_SIZE != BRICK_SIZE - 1 &&
+                                y % BRICK_SIZE != 0 && y % BRICK_SIZE != BRICK_SIZE - 1 &&
+                                z % BRICK_SIZE != 0 && z % BRICK_SIZE != BRICK_SIZE - 1)
+                                continue;
+                            if (_getVoxel(x, y, z) == Voxel::Air)
+                                continue;
+
+                            Sides sides = Side::NONE;
+
+                            if ((z == CHUNK_SIZE - 1 && !obstructions[0][x][y]) || (z != CHUNK_SIZE - 1 && _getVoxel(x, y, z + 1) == Voxel::Air))
+                            {
+                                sides |= Side::FRONT;
+                                needsDrawCount++;
+                            }
+                            if ((z == 0 && !obstructions[1][x][y]) || (z != 0 && _getVoxel(x, y, z - 1) == Voxel::Air))
+                            {
+                                sides |= Side::BACK;
+                                needsDrawCount++;
+                            }
+                            if ((x == 0 && !obstructions[2][y][z]) || (x != 0 && _getVoxel(x - 1, y, z) == Voxel::Air))
+                            {
+                                sides |= Side::LEFT;
+                                needsDrawCount++;
+                            }
+                            if ((x == CHUNK_SIZE - 1 && !obstructions[3][y][z]) || (x != CHUNK_SIZE - 1 && _getVoxel(x + 1, y, z) == Voxel::Air))
+                            {
+                                sides |= Side::RIGHT;
+                                needsDrawCount++;
+                            }
+                            if ((y == CHUNK_SIZE - 1 && !obstructions[4][x][z]) || (y != CHUNK_SIZE - 1 && _getVoxel(x, y + 1, z) == Voxel::Air))
+                            {
+                                sides |= Side::TOP;
+                                needsDrawCount++;
+                            }
+                            if ((y == 0 && !obstructions[5][x][z]) || (y != 0 && _getVoxel(x, y - 1, z) == Voxel::Air))
+                            {
+                                sides |= Side::BOTTOM;
+                                needsDrawCount++;
+                            }
+                            if (sides != Side::NONE)
+                            {
+                                needsDraw.write(x, y, z, sides);
+                                drawnBricks.set(brick);
+                            }
+                        }
+                    }
                 }
             }
         }
@@ -308,26 +766,26 @@ void Chunk::getObstructions(Side side, bool obstructions[CHUNK_SIZE][CHUNK_SIZE]
             switch (side)
             {
             case Side::FRONT: // Z = CHUNK_SIZE - 1
-                obstructed = voxel3d(i, j, CHUNK_SIZE - 1) != Voxel::Air;
+                obstructed = _getVoxel(i, j, CHUNK_SIZE - 1) != Voxel::Air;
                 break;
             case Side::BACK: // Z = 0
-                obstructed = voxel3d(i, j, 0) != Voxel::Air;
+                obstructed = _getVoxel(i, j, 0) != Voxel::Air;
                 break;
 
             case Side::LEFT: // X = 0
-                obstructed = voxel3d(0, i, j) != Voxel::Air;
+                obstructed = _getVoxel(0, i, j) != Voxel::Air;
                 break;
 
             case Side::RIGHT: // X = CHUNK_SIZE - 1
-                obstructed = voxel3d(CHUNK_SIZE - 1, i, j) != Voxel::Air;
+                obstructed = _getVoxel(CHUNK_SIZE - 1, i, j) != Voxel::Air;
                 break;
 
             case Side::TOP: // Y = CHUNK_SIZE - 1
-                obstructed = voxel3d(i, CHUNK_SIZE - 1, j) != Voxel::Air;
+                obstructed = _getVoxel(i, CHUNK_SIZE - 1, j) != Voxel::Air;
                 break;
 
             case Side::BOTTOM: // Y = 0
-                obstructed = voxel3d(i, 0, j) != Voxel::Air;
+                obstructed = _getVoxel(i, 0, j) != Voxel::Air;
                 break;
 
             default:
@@ -339,113 +797,338 @@ void Chunk::getObstructions(Side side, bool obstructions[CHUNK_SIZE][CHUNK_SIZE]
     }
 }
 
-void Chunk::generateMesh()
+bool Chunk::isOpaqueAt(int x, int y, int z)
 {
-    needsMeshUpdate = false;
-    needsMeshUpload = false;
+    bool outX = x < 0 || x >= CHUNK_SIZE;
+    bool outY = y < 0 || y >= CHUNK_SIZE;
+    bool outZ = z < 0 || z >= CHUNK_SIZE;
+    if (!outX && !outY && !outZ)
+        return _getVoxel(x, y, z) != Voxel::Air;
+
+    // The layers touching the chunk are in `obstructions`
+    if (outX + outY + outZ == 1)
+    {
+        if (outZ)
+            return obstructions[z < 0 ? 1 : 0][x][y];
+        if (outX)
+            return obstructions[x < 0 ? 2 : 3][y][z];
+        return obstructions[y < 0 ? 5 : 4][x][z];
+    }
 
-    if (meshVertices)
-        delete[] meshVertices;
-    meshVertices = new float[needsDrawCount * CubeMeshSides::values_per_face]();
+    // Along an edge of the chunk, the meshes are generated on the tick thread which owns the chunks
+    return world->getVoxel(m_x * CHUNK_SIZE + x, m_y * CHUNK_SIZE + y, m_z * CHUNK_SIZE + z) != Voxel::Air;
+}
 
-    if (meshNormals)
-        delete[] meshNormals;
-    meshNormals = new float[needsDrawCount * CubeMeshSides::values_per_face]();
+int Chunk::lightAt(int x, int y, int z, LightChannel channel)
+{
+    if (x >= 0 && x < CHUNK_SIZE && y >= 0 && y < CHUNK_SIZE && z >= 0 && z < CHUNK_SIZE)
+        return getLight(x, y, z, channel);
+    return world->getLight(m_x * CHUNK_SIZE + x, m_y * CHUNK_SIZE + y, m_z * CHUNK_SIZE + z, channel);
+}
 
-    if (meshColors)
-        delete[] meshColors;
-    meshColors = new int[needsDrawCount * CubeMeshSides::values_per_face / 3]();
+void Chunk::faceShading(int x, int y, int z, int side, int occlusion[4], int skyLight[4], int blockLight[4])
+{
+    // Axis of the normal of each side
+    static const int normalAxis[6] = {2, 2, 0, 0, 1, 1};
+    int axis = normalAxis[side];
+    int uAxis = (axis + 1) % 3, vAxis = (axis + 2) % 3;
 
-    int meshVerticesCount = 0;
-    if (isSimpleChunk && simpleChunkVoxel == Voxel::Air)
+    for (int c = 0; c < 4; c++)
     {
-        meshSize = meshVerticesCount / 3;
-
-        needsMeshUpload = true;
-        world->addToUploadQueue(this);
-        return;
+        // The three voxels around the corner, in the layer the face looks at
+        const int *corner = CubeMeshSides::corners[side][c];
+        glm::ivec3 front(x, y, z), u(0), v(0);
+        front[axis] += corner[axis];
+        u[uAxis] = corner[uAxis];
+        v[vAxis] = corner[vAxis];
+        glm::ivec3 a = front + u, b = front + v, diagonal = front + u + v;
+
+        bool sideA = isOpaqueAt(a.x, a.y, a.z);
+        bool sideB = isOpaqueAt(b.x, b.y, b.z);
+        bool sideDiagonal = isOpaqueAt(diagonal.x, diagonal.y, diagonal.z);
+        // Two sides already hide the diagonal one
+        occlusion[c] = sideA && sideB ? 0 : 3 - sideA - sideB - sideDiagonal;
+
+        // Average the light of the voxels the corner can see, the one in front of the face always counts
+        const glm::ivec3 samples[4] = {front, a, b, diagonal};
+        const bool open[4] = {true, !sideA, !sideB, !sideDiagonal && !(sideA && sideB)};
+        int count = 0, sky = 0, block = 0;
+        for (int s = 0; s < 4; s++)
+        {
+            if (!open[s])
+                continue;
+            int sampleSky = lightAt(samples[s].x, samples[s].y, samples[s].z, LightChannel::SkyLight);
+            if (sampleSky < 0)
+                continue; // Not loaded
+            sky += sampleSky;
+            block += lightAt(samples[s].x, samples[s].y, samples[s].z, LightChannel::BlockLight);
+            count++;
+        }
+        // Nothing loaded around, assume the sky is open like calculateLight does
+        skyLight[c] = count ? (sky + count / 2) / count : MAX_LIGHT_LEVEL;
+        blockLight[c] = count ? (block + count / 2) / count : 0;
     }
+}
 
-    int colorCount = 0;
-    for (int i = 0; i < CHUNK_SIZE; i++)
+void Chunk::generateMesh()
+{
+    needsMeshUpdate = false;
+    // Built aside, the main thread may still be uploading the previous mesh
+    ChunkMesh *mesh = new ChunkMesh();
+    mesh->pulled = vertexPulling.load(std::memory_order_relaxed);
+
+    // The faces are grouped by side, so that the sides facing away from the camera can be skipped when drawing
+    int sideFaces[6] = {0};
+    if (!(isSimpleChunk && simpleChunkVoxel == Voxel::Air))
     {
-        for (int j = 0; j < CHUNK_SIZE; j++)
+        for (int brick = 0; brick < BRICK_COUNT; brick++)
         {
-            for (int k = 0; k < CHUNK_SIZE; k++)
-            {
-                if (_getVoxel(i, j, k) == Voxel::Air)
-                    continue;
+            if (!drawnBricks[brick])
+                continue;
+            glm::ivec3 first = BrickStorage::brickOrigin(brick);
+            for (int i = first.x; i < first.x + BRICK_SIZE; i++)
+                for (int j = first.y; j < first.y + BRICK_SIZE; j++)
+                    for (int k = first.z; k < first.z + BRICK_SIZE; k++)
+                        for (int f = 0; f < 6; f++)
+                            sideFaces[f] += (needsDraw.get(i, j, k) >> f) & 1;
+        }
+    }
 
-                int n_faces = 0;
-                for (int f = 0; f < 6; f++)
-                {
-                    n_faces += (needsDraw[i][j][k] & (1 << f)) ? 1 : 0;
-                }
+    // Where each side starts, in vertices
+    int cursor[6];
+    int meshVerticesCount = 0;
+    for (int f = 0; f < 6; f++)
+    {
+        mesh->sideFirst[f] = cursor[f] = meshVerticesCount;
+        mesh->sideCount[f] = sideFaces[f] * 6;
+        meshVerticesCount += mesh->sideCount[f];
+    }
 
-                int block_vertices = CubeMeshSides::values_per_face * n_faces;
-                float *begin = &meshVertices[meshVerticesCount];
+    if (mesh->pulled)
+        mesh->faces.resize(meshVerticesCount / 6 * FACE_WORDS);
+    else
+    {
+        mesh->vertices.resize(meshVerticesCount * 3);
+        mesh->normals.resize(meshVerticesCount * 3);
+        mesh->colors.resize(meshVerticesCount);
+    }
 
-                float *end = CubeMeshSides::faces_at(i, j, k, needsDraw[i][j][k], begin);
+    // Bounding box of the voxels that have at least one face, in voxels
+    glm::ivec3 boundsMin(CHUNK_SIZE), boundsMax(-1);
 
-                for (int l = 0; l < block_vertices / 3; l++)
+    for (int brick = 0; brick < BRICK_COUNT && meshVerticesCount > 0; brick++)
+    {
+        if (!drawnBricks[brick])
+            continue;
+        glm::ivec3 first = BrickStorage::brickOrigin(brick);
+        for (int i = first.x; i < first.x + BRICK_SIZE; i++)
+        {
+            for (int j = first.y; j < first.y + BRICK_SIZE; j++)
+            {
+                for (int k = first.z; k < first.z + BRICK_SIZE; k++)
                 {
-                    meshColors[colorCount++] = _getVoxel(i, j, k);
-                }
+                    Sides sides = needsDraw.get(i, j, k);
+                    if (sides == Side::NONE || _getVoxel(i, j, k) == Voxel::Air)
+                        continue;
 
-                // Use normals_on to append the normals to the meshNormals vector
-                // Expand the meshNormals vector to make room for the new normals
-                float *beginNormals = &meshNormals[meshVerticesCount];
-                float *endNormals = CubeMeshSides::normals_on(needsDraw[i][j][k], beginNormals);
+                    boundsMin = glm::min(boundsMin, glm::ivec3(i, j, k));
+                    boundsMax = glm::max(boundsMax, glm::ivec3(i, j, k));
 
-                meshVerticesCount += (end - begin);
-                assert(end - begin == endNormals - beginNormals);
+                    for (int f = 0; f < 6; f++)
+                    {
+                        if (!(sides & (1 << f)))
+                            continue;
+
+                        int occlusion[4], skyLight[4], blockLight[4];
+                        faceShading(i, j, k, f, occlusion, skyLight, blockLight);
+
+                        // The cursor stays in vertices so that the side ranges are the same in both modes
+                        if (mesh->pulled)
+                        {
+                            uint32_t *record = &mesh->faces[cursor[f] / 6 * FACE_WORDS];
+                            record[0] = packFace(i, j, k, f, _getVoxel(i, j, k));
+                            record[1] = packOcclusion(occlusion, skyLight);
+                            record[2] = packBlockLight(blockLight);
+                            cursor[f] += 6;
+                            continue;
+                        }
+
+                        // 6 vertices of 3 floats for the position and the normal
+                        // The color holds the material and, above it, the occlusion and the light of the corner
+                        const int *triangles = CubeMeshSides::quad_triangles[flipQuad(occlusion)];
+                        for (int l = 0; l < 6; l++)
+                        {
+                            int c = triangles[l];
+                            const int *corner = CubeMeshSides::corners[f][c];
+                            for (int axis = 0; axis < 3; axis++)
+                            {
+                                mesh->vertices[cursor[f] * 3 + axis] = glm::ivec3(i, j, k)[axis] + corner[axis] * 0.5f;
+                                mesh->normals[cursor[f] * 3 + axis] = CubeMeshSides::faces_array_normals[f][axis];
+                            }
+                            mesh->colors[cursor[f]++] = packVertexColor(_getVoxel(i, j, k), occlusion[c], skyLight[c], blockLight[c]);
+                        }
+                    }
+                }
             }
         }
     }
 
-    meshSize = meshVerticesCount / 3;
+    mesh->size = meshVerticesCount;
+    if (meshVerticesCount > 0)
+    {
+        // Voxels are centered on integer coordinates
+        mesh->boundsMin = glm::vec3(boundsMin) - 0.5f;
+        mesh->boundsMax = glm::vec3(boundsMax) + 0.5f;
+    }
 
-    needsMeshUpload = true;
+    // Hand the mesh over, a previous one that was not taken yet is never uploaded
+    {
+        std::lock_guard<std::mutex> lock(meshMutex);
+        delete readyMesh;
+        readyMesh = mesh;
+        needsMeshUpload = true;
+    }
     world->addToUploadQueue(this);
 }
 
-void Chunk::uploadMesh()
+size_t Chunk::uploadMesh(size_t maxBytes)
 {
-    needsMeshUpload = false;
-    // Check if the VAO, VBO and EBO are initialized
+    // Take the last finished mesh, an upload in progress is dropped and the new mesh starts over
+    bool restart = false;
+    {
+        std::lock_guard<std::mutex> lock(meshMutex);
+        if (readyMesh != nullptr)
+        {
+            delete uploadingMesh;
+            uploadingMesh = readyMesh;
+            readyMesh = nullptr;
+            restart = true;
+        }
+        if (uploadingMesh == nullptr)
+        {
+            needsMeshUpload = false;
+            return 0;
+        }
+    }
+    const ChunkMesh &mesh = *uploadingMesh;
+
+    // The buffer holds all the positions, then all the colors, then all the normals
+    // or only the face records when the mesh is pulled
+    struct Part
+    {
+        size_t offset, size;
+        const void *data;
+    };
+    const size_t meshSize = mesh.size;
+    const Part vertexParts[3] = {
+        {0, meshSize * 3 * sizeof(float), mesh.vertices.data()},
+        {meshSize * 3 * sizeof(float), meshSize * sizeof(int), mesh.colors.data()},
+        {meshSize * (3 * sizeof(float) + sizeof(int)), meshSize * 3 * sizeof(float), mesh.normals.data()},
+    };
+    const Part faceParts[1] = {
+        {0, meshSize / 6 * FACE_BYTES, mesh.faces.data()},
+    };
+    const Part *parts = mesh.pulled ? faceParts : vertexParts;
+    const int partsCount = mesh.pulled ? 1 : 3;
+    const size_t totalBytes = mesh.pulled ? faceParts[0].size : meshSize * VERTEX_BYTES;
+
+    if (restart)
+    {
+        uploadOffset = 0;
+        if (totalBytes)
+        {
+            if (!uploadVBO)
+                glGenBuffers(1, &uploadVBO);
+            glBindBuffer(GL_ARRAY_BUFFER, uploadVBO);
+            glBufferData(GL_ARRAY_BUFFER, totalBytes, NULL, GL_DYNAMIC_DRAW);
+        }
+    }
+
+    size_t end = std::min(totalBytes, uploadOffset + maxBytes);
+    size_t uploaded = end - uploadOffset;
+    if (uploaded)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, uploadVBO);
+        for (int p = 0; p < partsCount; p++)
+        {
+            const Part &part = parts[p];
+            size_t from = std::max(uploadOffset, part.offset);
+            size_t to = std::min(end, part.offset + part.size);
+            if (from < to)
+                glBufferSubData(GL_ARRAY_BUFFER, from, to - from, (const char *)part.data + (from - part.offset));
+        }
+        uploadOffset = end;
+    }
+
+    if (uploadOffset < totalBytes)
+        return uploaded; // Not done yet, keep drawing the previous mesh
+
+    drawSize = mesh.size;
+    drawPulled = mesh.pulled;
+    drawBoundsMin = mesh.boundsMin;
+    drawBoundsMax = mesh.boundsMax;
+    for (int f = 0; f < 6; f++)
+    {
+        drawSideFirst[f] = mesh.sideFirst[f];
+        drawSideCount[f] = mesh.sideCount[f];
+    }
+    // The arrays are not needed once on the GPU
+    {
+        std::lock_guard<std::mutex> lock(meshMutex);
+        delete uploadingMesh;
+        uploadingMesh = nullptr;
+        needsMeshUpload = readyMesh != nullptr;
+    }
+    if (drawSize == 0)
+        return uploaded; // Keep the buffers, draw() skips empty meshes
+
+    // Check if the VAO is initialized
     if (!hasBuffer)
     {
         glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
         // glGenBuffers(1, &EBO);
 
         hasBuffer = true;
     }
-    glBindVertexArray(VAO);
 
+    // The freshly uploaded buffer becomes the one we draw
+    std::swap(VBO, uploadVBO);
+
+    glBindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    // Make room for 3 floats coords , 1 int color and 3 floats normals
-    glBufferData(GL_ARRAY_BUFFER, meshSize * (3 * sizeof(float) + sizeof(int) + 3 * sizeof(float)), NULL, GL_DYNAMIC_DRAW);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, meshSize * 3 * sizeof(float), meshVertices);
-    glBufferSubData(GL_ARRAY_BUFFER, meshSize * 3 * sizeof(float), meshSize * sizeof(int), meshColors);
-    glBufferSubData(GL_ARRAY_BUFFER, meshSize * (3 * sizeof(float) + sizeof(int)), meshSize * 3 * sizeof(float), meshNormals);
 
     // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     // glBufferData(GL_ELEMENT_ARRAY_BUFFER, meshIndices.size() * sizeof(unsigned int), meshIndices.data(), GL_STATIC_DRAW);
 
+    if (drawPulled)
+    {
+        // No vertex attributes, pulled.vert fetches the face records from the texture buffer
+        for (int attribute = 0; attribute < 3; attribute++)
+            glDisableVertexAttribArray(attribute);
+        glBindVertexArray(0);
+
+        if (!faceTexture)
+            glGenTextures(1, &faceTexture);
+        glBindTexture(GL_TEXTURE_BUFFER, faceTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, VBO);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        return uploaded;
+    }
+
     // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)vertexParts[0].offset);
     glEnableVertexAttribArray(0);
 
     // Color attribute
-    glVertexAttribIPointer(1, 1, GL_INT, sizeof(int), (void *)(meshSize * 3 * sizeof(float)));
+    glVertexAttribIPointer(1, 1, GL_INT, sizeof(int), (void *)vertexParts[1].offset);
     glEnableVertexAttribArray(1);
 
     // Normal attribute
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)(meshSize * (3 * sizeof(float) + sizeof(int))));
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)vertexParts[2].offset);
     glEnableVertexAttribArray(2);
 
     glBindVertexArray(0);
+    return uploaded;
 }
 
 void Chunk::discard()
@@ -453,20 +1136,50 @@ void Chunk::discard()
     if (hasBuffer)
     {
         glDeleteVertexArrays(1, &VAO);
-        glDeleteBuffers(1, &VBO);
         // glDeleteBuffers(1, &EBO);
         hasBuffer = false;
     }
+    if (VBO)
+        glDeleteBuffers(1, &VBO);
+    if (uploadVBO)
+        glDeleteBuffers(1, &uploadVBO);
+    VBO = uploadVBO = 0;
+    if (faceTexture)
+        glDeleteTextures(1, &faceTexture);
+    faceTexture = 0;
+    drawSize = 0;
+    for (int slot = 0; slot < 2; slot++)
+    {
+        if (occlusionQueries[slot])
+            glDeleteQueries(1, &occlusionQueries[slot]);
+        occlusionQueries[slot] = 0;
+        occlusionQueryFrames[slot] = -1;
+    }
 
     scheduledForDeletion = true;
 }
 
-void Chunk::draw(Shader *shader)
+size_t Chunk::getDrawBytes()
+{
+    return drawPulled ? drawSize / 6 * FACE_BYTES : drawSize * VERTEX_BYTES;
+}
+
+unsigned int Chunk::getOcclusionQuery(int slot)
+{
+    if (!occlusionQueries[slot])
+    {
+        glGenQueries(1, &occlusionQueries[slot]);
+        occlusionQueryFrames[slot] = -1;
+    }
+    return occlusionQueries[slot];
+}
+
+void Chunk::draw(Shader *shader, glm::vec3 cameraPosition)
 {
     if (isEmpty())
         return;
 
-    if (meshSize == 0)
+    if (drawSize == 0)
         return;
 
     if (!hasBuffer || scheduledForDeletion)
@@ -479,9 +1192,48 @@ void Chunk::draw(Shader *shader)
     shader->setMat4("model", m_modelMatrix);
     shader->setMat4("invModel", m_invModelMatrix);
 
+    // A side can only face the camera if the camera is on its outer side of at least one of its faces
+    glm::vec3 camera = cameraPosition - glm::vec3(m_x, m_y, m_z) * (float)CHUNK_SIZE;
+    const bool facing[6] = {
+        camera.z > drawBoundsMin.z, // FRONT
+        camera.z < drawBoundsMax.z, // BACK
+        camera.x < drawBoundsMax.x, // LEFT
+        camera.x > drawBoundsMin.x, // RIGHT
+        camera.y > drawBoundsMin.y, // TOP
+        camera.y < drawBoundsMax.y, // BOTTOM
+    };
+
+    // Submit the ranges of the sides facing the camera, merging the adjacent ones
+    GLint first[6];
+    GLsizei count[6];
+    int ranges = 0;
+    for (int f = 0; f < 6; f++)
+    {
+        if (!facing[f] || drawSideCount[f] == 0)
+            continue;
+        if (ranges > 0 && first[ranges - 1] + count[ranges - 1] == drawSideFirst[f])
+            count[ranges - 1] += drawSideCount[f];
+        else
+        {
+            first[ranges] = drawSideFirst[f];
+            count[ranges] = drawSideCount[f];
+            ranges++;
+        }
+    }
+    if (ranges == 0)
+        return;
+
+    // gl_VertexID starts at `first`, so pulled.vert finds the face of each vertex without an offset
+    if (drawPulled)
+    {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_BUFFER, faceTexture);
+    }
+
     glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, meshSize);
+    glMultiDrawArrays(GL_TRIANGLES, first, count, ranges);
     glBindVertexArray(0);
+    drawCalls++;
 }
 
 void Chunk::print_info()
@@ -489,7 +1241,7 @@ void Chunk::print_info()
     log_debug("Chunk (%d, %d, %d)", m_x, m_y, m_z);
     log_debug("  isSimpleChunk: %s", isSimpleChunk ? "true" : "false");
     log_debug("  simpleChunkVoxel: %d", simpleChunkVoxel);
-    log_debug("  meshSize: %d", meshSize);
+    log_debug("  drawSize: %d", drawSize);
     log_debug("  VAO: %d, VBO: %d, EBO: %d", VAO, VBO, EBO);
     log_debug("  Position: %d %d %d", m_x, m_y, m_z);
     log_debug("  Edge changed: %s", edgeChanged == Side::NONE ? "NONE" : "SOME");
@@ -0,0 +1,29 @@
+#include "testgl/chunkhandle.hpp"
+
+ChunkHandle ChunkHandleTable::insert(Chunk *chunk)
+{
+    if (freeSlots.empty())
+    {
+        // Generation 0 is never valid so that a zero-initialized handle is always stale
+        slots.push_back({chunk, 1});
+        return ChunkHandle{(uint32_t)slots.size() - 1, 1};
+    }
+
+    uint32_t index = freeSlots.back();
+    freeSlots.pop_back();
+    slots[index].chunk = chunk;
+    return ChunkHandle{index, slots[index].generation};
+}
+
+void ChunkHandleTable::release(ChunkHandle handle)
+{
+    if (get(handle) == nullptr)
+        return;
+
+    Slot &slot = slots[handle.index];
+    slot.chunk = nullptr;
+    slot.generation++;
+    if (slot.generation == 0) // Skip the invalid generation on wrap around
+        slot.generation = 1;
+    freeSlots.push_back(handle.index);
+}
@@ -4,6 +4,7 @@
 #include <glm/glm.hpp>
 #include <cstring>
 #include <vector>
+#include <utility>
 
 namespace CubeMeshSides
 {
@@ -111,4 +112,12 @@ ChunkPos dirFromSide(Side side)
     default:
         return ChunkPos(0, 0, 0);
     }
+}
+
+int side_pair_index(int a, int b)
+{
+    if (a > b)
+        std::swap(a, b);
+    // Pairs starting with a come after the 5 + 4 + ... pairs starting with a smaller index
+    return a * (11 - a) / 2 + (b - a - 1);
 }
\ No newline at end of file
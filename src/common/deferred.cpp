@@ -0,0 +1,179 @@
+#include "testgl/deferred.hpp"
+#include "testgl/frameuniforms.hpp"
+#include "testgl/profiler.hpp"
+#include "testgl/voxel.hpp"
+
+#include <algorithm>
+
+bool DeferredRenderer::enabled = DEFERRED_SHADING;
+
+DeferredRenderer::DeferredRenderer(int width, int height) : FBO(0), normalTexture(0), materialTexture(0), depthTexture(0),
+                                                            width(width), height(height), renderWidth(width), renderHeight(height),
+                                                            geometryShader("../shaders/base.vert", "../shaders/gbuffer.frag"),
+                                                            pulledGeometryShader("../shaders/pulled.vert", "../shaders/gbuffer.frag"),
+                                                            lightingShader("../shaders/lighting.vert", "../shaders/lighting.frag"),
+                                                            lights(), lightsChanged(true)
+{
+    for (Shader *shader : {&geometryShader, &pulledGeometryShader, &lightingShader})
+    {
+        ShaderData::setupMaterials(shader);
+        FrameUniforms::attach(shader);
+    }
+
+    // G-buffer texture units
+    lightingShader.use();
+    lightingShader.setInt("gNormal", 0);
+    lightingShader.setInt("gMaterial", 1);
+    lightingShader.setInt("gDepth", 2);
+
+    unsigned int blockIndex = glGetUniformBlockIndex(lightingShader.ID, "Lights");
+    if (blockIndex != GL_INVALID_INDEX)
+        glUniformBlockBinding(lightingShader.ID, blockIndex, POINT_LIGHTS_BINDING);
+
+    glGenBuffers(1, &lightsUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, lightsUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(GPULights), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, POINT_LIGHTS_BINDING, lightsUBO);
+
+    // The full-screen triangle is generated from gl_VertexID
+    glGenVertexArrays(1, &VAO);
+
+    createTargets();
+}
+
+DeferredRenderer::~DeferredRenderer()
+{
+    deleteTargets();
+    glDeleteBuffers(1, &lightsUBO);
+    glDeleteVertexArrays(1, &VAO);
+}
+
+void DeferredRenderer::createTargets()
+{
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+    const struct
+    {
+        unsigned int *texture;
+        GLint internalFormat;
+        GLenum format, type, attachment;
+    } targets[3] = {
+        // Normals are stored as n * 0.5 + 0.5
+        {&normalTexture, GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT0},
+        // Material index, then the baked ambient occlusion, sky and block light
+        {&materialTexture, GL_RGBA8UI, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT1},
+        // The fragment positions are rebuilt from the depth
+        {&depthTexture, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, GL_DEPTH_STENCIL_ATTACHMENT},
+    };
+    for (auto &target : targets)
+    {
+        glGenTextures(1, target.texture);
+        glBindTexture(GL_TEXTURE_2D, *target.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, target.internalFormat, width, height, 0, target.format, target.type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, target.attachment, GL_TEXTURE_2D, *target.texture, 0);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    const GLenum drawBuffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, drawBuffers);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        log_error("G-buffer framebuffer is not complete");
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DeferredRenderer::deleteTargets()
+{
+    glDeleteFramebuffers(1, &FBO);
+    unsigned int textures[3] = {normalTexture, materialTexture, depthTexture};
+    glDeleteTextures(3, textures);
+    FBO = normalTexture = materialTexture = depthTexture = 0;
+}
+
+void DeferredRenderer::resize(int width, int height)
+{
+    if (width == this->width && height == this->height)
+        return;
+    // Minimized windows have a 0x0 framebuffer
+    if (width <= 0 || height <= 0)
+        return;
+    this->width = width;
+    this->height = height;
+    deleteTargets();
+    createTargets();
+}
+
+bool DeferredRenderer::addLight(glm::vec3 position, float radius, glm::vec3 color)
+{
+    if (lights.count == MAX_POINT_LIGHTS)
+        return false;
+    lights.lights[lights.count++] = {glm::vec4(position, radius), glm::vec4(color, 1.0f)};
+    lightsChanged = true;
+    return true;
+}
+
+void DeferredRenderer::clearLights()
+{
+    lights.count = 0;
+    lightsChanged = true;
+}
+
+void DeferredRenderer::beginGeometry(int renderWidth, int renderHeight)
+{
+    this->renderWidth = std::min(renderWidth, width);
+    this->renderHeight = std::min(renderHeight, height);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glViewport(0, 0, this->renderWidth, this->renderHeight);
+
+    const GLfloat clearNormal[4] = {0.5f, 0.5f, 0.5f, 0.0f};
+    const GLuint clearMaterial[4] = {0, 0, 0, 0};
+    glClearBufferfv(GL_COLOR, 0, clearNormal);
+    glClearBufferuiv(GL_COLOR, 1, clearMaterial);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void DeferredRenderer::shade(const glm::mat4 &view, const glm::mat4 &projection, unsigned int framebuffer)
+{
+    profile_scope(Lighting);
+    profile_gpu_begin(Lighting);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, renderWidth, renderHeight);
+
+    if (lightsChanged)
+    {
+        // Only the lights in use are sent
+        glBindBuffer(GL_UNIFORM_BUFFER, lightsUBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, offsetof(GPULights, lights) + lights.count * sizeof(GPUPointLight), &lights);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        lightsChanged = false;
+    }
+
+    const unsigned int textures[3] = {normalTexture, materialTexture, depthTexture};
+    for (int i = 0; i < 3; i++)
+    {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    lightingShader.use();
+    lightingShader.setMat4("invViewProjection", glm::inverse(projection * view));
+    lightingShader.setVec2("uvScale", glm::vec2((float)renderWidth / width, (float)renderHeight / height));
+
+    // One triangle covering the screen, the sky pixels are discarded and keep the clear color
+    glDisable(GL_DEPTH_TEST);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glBindVertexArray(VAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glEnable(GL_DEPTH_TEST);
+
+    profile_gpu_end();
+}
@@ -0,0 +1,198 @@
+#include "testgl/farterrain.hpp"
+#include "testgl/chunkpos.hpp"
+#include "testgl/frameuniforms.hpp"
+#include "testgl/profiler.hpp"
+#include "testgl/voxel.hpp"
+#include "testgl/worldgen.hpp"
+
+#include <vector>
+
+// Vertices per side of the grid, one texel of each level is left unused so that the grid has an even number of cells
+#define CLIPMAP_GRID (CLIPMAP_SIZE - 1)
+
+static_assert((CLIPMAP_SIZE & (CLIPMAP_SIZE - 1)) == 0, "The clipmap is addressed with a mask");
+
+bool FarTerrain::enabled = FAR_TERRAIN;
+
+FarTerrain::FarTerrain() : shader("../shaders/farterrain.vert", "../shaders/farterrain.frag"), updatedSamples(0)
+{
+    ShaderData::setupMaterials(&shader);
+    FrameUniforms::attach(&shader);
+    shader.use();
+    shader.setInt("heights", 0);
+    shader.setFloat("spacing", CLIPMAP_SPACING);
+    shader.setFloat("morphBand", CLIPMAP_MORPH_BAND);
+
+    for (int level = 0; level < CLIPMAP_LEVELS; level++)
+        valid[level] = false;
+
+    glGenTextures(1, &heightTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, heightTexture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RG32F, CLIPMAP_SIZE, CLIPMAP_SIZE, CLIPMAP_LEVELS, 0, GL_RG, GL_FLOAT, nullptr);
+    // Only read with texelFetch, but the texture must be complete
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    // One grid shared by every level, the vertices are the sample coordinates inside the level
+    std::vector<float> vertices;
+    vertices.reserve(CLIPMAP_GRID * CLIPMAP_GRID * 2);
+    for (int z = 0; z < CLIPMAP_GRID; z++)
+    {
+        for (int x = 0; x < CLIPMAP_GRID; x++)
+        {
+            vertices.push_back(x);
+            vertices.push_back(z);
+        }
+    }
+    // Two triangles per cell, counter-clockwise seen from above
+    std::vector<unsigned int> indices;
+    indices.reserve((CLIPMAP_GRID - 1) * (CLIPMAP_GRID - 1) * 6);
+    for (int z = 0; z < CLIPMAP_GRID - 1; z++)
+    {
+        for (int x = 0; x < CLIPMAP_GRID - 1; x++)
+        {
+            unsigned int corner = z * CLIPMAP_GRID + x;
+            unsigned int cell[6] = {corner, corner + CLIPMAP_GRID, corner + 1,
+                                    corner + 1, corner + CLIPMAP_GRID, corner + CLIPMAP_GRID + 1};
+            indices.insert(indices.end(), cell, cell + 6);
+        }
+    }
+    indexCount = indices.size();
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+    // Grid coordinates attribute
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
+    glEnableVertexAttribArray(0);
+
+    glBindVertexArray(0);
+}
+
+FarTerrain::~FarTerrain()
+{
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteTextures(1, &heightTexture);
+}
+
+void FarTerrain::updateColumns(int level, glm::ivec2 origin, int first, int count)
+{
+    int spacing = CLIPMAP_SPACING << level;
+    // One column, in texel order
+    float data[CLIPMAP_SIZE * 2] = {};
+    for (int x = first; x < first + count; x++)
+    {
+        for (int z = origin.y; z < origin.y + CLIPMAP_GRID; z++)
+        {
+            Voxel voxel;
+            float *texel = &data[(z & (CLIPMAP_SIZE - 1)) * 2];
+            WorldGenerator::classicSurface(x * spacing, z * spacing, &texel[0], &voxel);
+            texel[1] = voxel;
+        }
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x & (CLIPMAP_SIZE - 1), 0, level, 1, CLIPMAP_SIZE, 1, GL_RG, GL_FLOAT, data);
+    }
+    updatedSamples += count * CLIPMAP_GRID;
+}
+
+void FarTerrain::updateRows(int level, glm::ivec2 origin, int first, int count)
+{
+    int spacing = CLIPMAP_SPACING << level;
+    // One row, in texel order
+    float data[CLIPMAP_SIZE * 2] = {};
+    for (int z = first; z < first + count; z++)
+    {
+        for (int x = origin.x; x < origin.x + CLIPMAP_GRID; x++)
+        {
+            Voxel voxel;
+            float *texel = &data[(x & (CLIPMAP_SIZE - 1)) * 2];
+            WorldGenerator::classicSurface(x * spacing, z * spacing, &texel[0], &voxel);
+            texel[1] = voxel;
+        }
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, z & (CLIPMAP_SIZE - 1), level, CLIPMAP_SIZE, 1, 1, GL_RG, GL_FLOAT, data);
+    }
+    updatedSamples += count * CLIPMAP_GRID;
+}
+
+void FarTerrain::update(glm::vec3 cameraPosition)
+{
+    if (!enabled)
+        return;
+    profile_scope(Terrain);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, heightTexture);
+    for (int level = 0; level < CLIPMAP_LEVELS; level++)
+    {
+        // Snapped to two samples so that every other vertex is a vertex of the coarser level
+        float spacing = getSpacing(level);
+        glm::ivec2 origin = glm::ivec2(glm::floor(glm::vec2(cameraPosition.x, cameraPosition.z) / (2.0f * spacing))) * 2 - CLIPMAP_SIZE / 2;
+        if (valid[level] && origin == origins[level])
+            continue;
+
+        // The samples that stay in the level keep their texel
+        glm::ivec2 delta = origin - origins[level];
+        if (!valid[level] || abs(delta.x) >= CLIPMAP_GRID || abs(delta.y) >= CLIPMAP_GRID)
+            updateColumns(level, origin, origin.x, CLIPMAP_GRID);
+        else
+        {
+            if (delta.x > 0)
+                updateColumns(level, origin, origins[level].x + CLIPMAP_GRID, delta.x);
+            else if (delta.x < 0)
+                updateColumns(level, origin, origin.x, -delta.x);
+            if (delta.y > 0)
+                updateRows(level, origin, origins[level].y + CLIPMAP_GRID, delta.y);
+            else if (delta.y < 0)
+                updateRows(level, origin, origin.y, -delta.y);
+        }
+        origins[level] = origin;
+        valid[level] = true;
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void FarTerrain::draw(const glm::mat4 &projection, glm::vec3 cameraPosition)
+{
+    if (!enabled)
+        return;
+    profile_scope(Terrain);
+    profile_gpu_begin(Terrain);
+
+    // Same projection with a depth range reaching the coarsest level
+    float near = CLIPMAP_NEAR_PLANE;
+    float far = getSpacing(CLIPMAP_LEVELS - 1) * CLIPMAP_SIZE;
+    glm::mat4 farProjection = projection;
+    farProjection[2][2] = -(far + near) / (far - near);
+    farProjection[3][2] = -2.0f * far * near / (far - near);
+
+    // The chunks around the camera are drawn instead, except in the overlap
+    ChunkPos cameraChunk = ChunkPosTools::fromWorldPos(cameraPosition);
+    glm::vec2 chunksMin = glm::vec2(ChunkPosTools::getX(cameraChunk) - VIEW_DISTANCE, ChunkPosTools::getZ(cameraChunk) - VIEW_DISTANCE) * (float)CHUNK_SIZE;
+    glm::vec2 chunksMax = chunksMin + (float)((2 * VIEW_DISTANCE + 1) * CHUNK_SIZE);
+    // The voxels are centered on their coordinates
+    glm::vec2 areaMin = chunksMin - 0.5f + CLIPMAP_OVERLAP;
+    glm::vec2 areaMax = chunksMax - 0.5f - CLIPMAP_OVERLAP;
+
+    shader.use();
+    shader.setMat4("farProjection", farProjection);
+    shader.setVec4("voxelArea", areaMin.x, areaMin.y, areaMax.x, areaMax.y);
+    glUniform2iv(glGetUniformLocation(shader.ID, "origins"), CLIPMAP_LEVELS, &origins[0].x);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, heightTexture);
+    glBindVertexArray(VAO);
+    // One instance per level
+    glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, CLIPMAP_LEVELS);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    profile_gpu_end();
+}
@@ -0,0 +1,49 @@
+#include "testgl/frameuniforms.hpp"
+#include "testgl/constants.hpp"
+
+FrameUniforms::FrameUniforms() : data()
+{
+    glGenBuffers(1, &UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(Data), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    bind();
+}
+
+FrameUniforms::~FrameUniforms()
+{
+    glDeleteBuffers(1, &UBO);
+}
+
+void FrameUniforms::attach(Shader *shader)
+{
+    shader->wait();
+    unsigned int blockIndex = glGetUniformBlockIndex(shader->ID, "Frame");
+    if (blockIndex == GL_INVALID_INDEX)
+    {
+        log_warn("Shader %u has no Frame uniform block", shader->ID);
+        return;
+    }
+    glUniformBlockBinding(shader->ID, blockIndex, FRAME_UNIFORMS_BINDING);
+}
+
+void FrameUniforms::setCamera(const glm::mat4 &view, const glm::mat4 &projection, glm::vec3 viewPos)
+{
+    data.view = view;
+    data.projection = projection;
+    data.viewPos = viewPos;
+}
+
+void FrameUniforms::upload()
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    // Orphan the previous storage so that the driver never waits for the last frame to finish reading it
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(Data), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Data), &data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void FrameUniforms::bind()
+{
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, UBO);
+}
@@ -0,0 +1,225 @@
+#include "testgl/headless.hpp"
+#include "testgl/constants.hpp"
+#include "testgl/logging.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <glad/glad.h>
+
+namespace headless
+{
+    Options parseArguments(int argc, char **argv)
+    {
+        Options options = {false, HEADLESS_FRAMES, false, !BRICK_STORAGE, HEADLESS_OUTPUT_PATH};
+        for (int i = 1; i < argc; i++)
+        {
+            if (strcmp(argv[i], "--headless") == 0)
+                options.enabled = true;
+            else if (strncmp(argv[i], "--frames=", 9) == 0)
+                options.frames = std::max(1, atoi(argv[i] + 9));
+            else if (strcmp(argv[i], "--hash") == 0)
+                options.hash = true;
+            else if (strcmp(argv[i], "--dense") == 0)
+                options.dense = true;
+            else if (strncmp(argv[i], "--output=", 9) == 0)
+                options.output = argv[i] + 9;
+            else
+                log_warn("Unknown argument %s", argv[i]);
+        }
+        return options;
+    }
+
+    void followPath(Player *player, int frame)
+    {
+        // One turn every HEADLESS_FRAMES frames, looking where the camera goes
+        float angle = frame * 2.0f * (float)M_PI / HEADLESS_FRAMES;
+        glm::vec3 position(std::cos(angle) * HEADLESS_PATH_RADIUS, HEADLESS_PATH_HEIGHT, std::sin(angle) * HEADLESS_PATH_RADIUS);
+        player->setPose(position, glm::degrees(angle) + 90.0f, HEADLESS_PATH_PITCH);
+    }
+
+    void FrameTimes::report(const char *path)
+    {
+        if (times.empty())
+            return;
+
+        std::vector<float> sorted = times;
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&](float p)
+        { return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))]; };
+        float total = 0.0f;
+        for (float time : times)
+            total += time;
+
+        log_info("%d frames: avg %.3fms, min %.3fms, median %.3fms, p95 %.3fms, p99 %.3fms, max %.3fms", (int)times.size(),
+                 total / times.size(), sorted.front(), percentile(0.5f), percentile(0.95f), percentile(0.99f), sorted.back());
+
+        FILE *file = fopen(path, "w");
+        if (file == nullptr)
+        {
+            log_error("Could not open %s to write the frame times", path);
+            return;
+        }
+        fprintf(file, "frame,ms\n");
+        for (size_t i = 0; i < times.size(); i++)
+            fprintf(file, "%d,%.4f\n", (int)i, times[i]);
+        fclose(file);
+        log_info("Frame times written to %s", path);
+    }
+
+    // Highest voxel that is not air under `position`, false if there is none within the view distance
+    static bool findGround(World *world, glm::vec3 position, glm::ivec3 *ground)
+    {
+        int x = (int)std::floor(position.x + 0.5f), z = (int)std::floor(position.z + 0.5f);
+        // Voxels are centered on integer coordinates
+        for (int y = (int)std::floor(position.y + 0.5f); y > position.y - VIEW_DISTANCE * CHUNK_SIZE; y--)
+        {
+            if (world->getVoxel(x, y, z) == Voxel::Air)
+                continue;
+            *ground = glm::ivec3(x, y, z);
+            return true;
+        }
+        return false;
+    }
+
+    float editTerrain(World *world, glm::vec3 position)
+    {
+        auto start = std::chrono::steady_clock::now();
+        glm::ivec3 ground;
+        if (findGround(world, position, &ground))
+            world->setVoxel(ground.x, ground.y, ground.z, Voxel::Air);
+        world->settle();
+        return std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void benchmarkBulkEdit(World *world, glm::vec3 position)
+    {
+        glm::ivec3 center;
+        if (!findGround(world, position, &center))
+            return;
+        const int radius = HEADLESS_SPHERE_RADIUS;
+        glm::ivec3 min = center - radius, max = center + radius;
+        VoxelRegion saved = world->copy(min, max);
+        VoxelRegion sphere = VoxelRegion::sphere(radius);
+
+        // Time an edit until its meshes are uploaded, with the chunks it meshed, then put the terrain back
+        auto measure = [&](auto edit, int *meshedChunks)
+        {
+            int meshedBefore = world->buildStats.meshedChunks;
+            auto start = std::chrono::steady_clock::now();
+            edit();
+            world->settle();
+            float time = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - start).count();
+            *meshedChunks = world->buildStats.meshedChunks - meshedBefore;
+            world->paste(min, saved);
+            world->settle();
+            return time;
+        };
+
+        int bulkMeshes = 0, voxelMeshes = 0, voxels = 0;
+        float bulkTime = measure([&]()
+                                 { world->fillSphere(center, radius, Voxel::Air); },
+                                 &bulkMeshes);
+        float voxelTime = measure([&]()
+                                  {
+                                      for (int z = 0; z <= 2 * radius; z++)
+                                          for (int y = 0; y <= 2 * radius; y++)
+                                              for (int x = 0; x <= 2 * radius; x++)
+                                                  if (sphere.isWritten(x, y, z))
+                                                  {
+                                                      world->setVoxel(min.x + x, min.y + y, min.z + z, Voxel::Air);
+                                                      voxels++;
+                                                  } },
+                                  &voxelMeshes);
+        log_info("Sphere of %d voxels dug: fillSphere %.2fms (%d chunks meshed), setVoxel per voxel %.2fms (%d chunks meshed)", voxels,
+                 bulkTime, bulkMeshes, voxelTime, voxelMeshes);
+    }
+
+    void ChunkStats::report(World *world)
+    {
+        const World::BuildStats &build = world->buildStats;
+        log_info("Chunks of %d voxels: %d generated in %.1fms (%.3fms each), %d meshed in %.1fms (%.3fms each)", CHUNK_SIZE,
+                 build.generatedChunks, build.generationTime, build.generationTime / std::max(1, build.generatedChunks),
+                 build.meshedChunks, build.meshingTime, build.meshingTime / std::max(1, build.meshedChunks));
+        if (!settleTimes.empty())
+        {
+            float total = 0.0f, worst = 0.0f;
+            for (float time : settleTimes)
+            {
+                total += time;
+                worst = std::max(worst, time);
+            }
+            log_info("World built in %.1fms before the first frame, then %.3fms avg and %.3fms max per frame", buildTime,
+                     total / settleTimes.size(), worst);
+        }
+        if (frames > 0)
+            log_info("Chunks of %d voxels: %.1f chunk draw calls per frame", CHUNK_SIZE, (float)drawCalls / frames);
+        if (!editLatencies.empty())
+        {
+            float total = 0.0f, worst = 0.0f;
+            for (float latency : editLatencies)
+            {
+                total += latency;
+                worst = std::max(worst, latency);
+            }
+            log_info("Chunks of %d voxels: %d edits, %.3fms avg and %.3fms max until the meshes are uploaded", CHUNK_SIZE,
+                     (int)editLatencies.size(), total / editLatencies.size(), worst);
+        }
+    }
+
+    void benchmarkRaycast(World *world, glm::vec3 position)
+    {
+        int hits = 0;
+        float hitDistances = 0.0f;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < HEADLESS_RAYS; i++)
+        {
+            // Fibonacci sphere, the same directions in every run
+            float y = 1.0f - 2.0f * (i + 0.5f) / HEADLESS_RAYS;
+            float radius = std::sqrt(1.0f - y * y);
+            float angle = i * 2.39996323f; // Golden angle, in radians
+            World::RaycastHit hit;
+            if (world->raycast(position, glm::vec3(std::cos(angle) * radius, y, std::sin(angle) * radius), HEADLESS_RAY_REACH, &hit))
+            {
+                hits++;
+                hitDistances += hit.distance;
+            }
+        }
+        float time = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - start).count();
+        log_info("Raycast: %d rays of %.0f voxels in %.1fms (%.0f rays/s), %d hits %.1f voxels away on average", HEADLESS_RAYS,
+                 HEADLESS_RAY_REACH, time, HEADLESS_RAYS / (time / 1000.0f), hits, hitDistances / std::max(1, hits));
+    }
+
+    bool hashFramebuffer(unsigned int framebuffer, int width, int height, uint64_t *hash)
+    {
+        // Errors left by the frame must not be mistaken for a failed read
+        while (glGetError() != GL_NO_ERROR)
+            ;
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        GLenum status = glCheckFramebufferStatus(GL_READ_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            log_error("Could not hash the frame, framebuffer %u is not complete (0x%x)", framebuffer, status);
+            return false;
+        }
+        std::vector<unsigned char> pixels((size_t)width * height * 4);
+        glReadBuffer(framebuffer != 0 ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        GLenum error = glGetError();
+        if (error != GL_NO_ERROR)
+        {
+            log_error("Could not hash the frame, reading the pixels failed (0x%x)", error);
+            return false;
+        }
+
+        *hash = 0xCBF29CE484222325ull;
+        for (unsigned char c : pixels)
+            *hash = (*hash ^ c) * 0x100000001B3ull;
+        return true;
+    }
+} // namespace headless
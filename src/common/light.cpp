@@ -0,0 +1,322 @@
+#include "testgl/light.hpp"
+#include "testgl/profiler.hpp"
+
+using namespace ChunkPosTools;
+
+// Offsets to the 6 neighbors of a voxel, the sky light falls without loss along the last one
+static const int neighborOffsets[6][3] = {{1, 0, 0}, {-1, 0, 0}, {0, 0, 1}, {0, 0, -1}, {0, 1, 0}, {0, -1, 0}};
+#define DOWN 5
+
+LightEngine::LightEngine(std::map<ChunkPos, Chunk *> &chunks) : chunks(chunks), cachedPos(0, 0, 0), cachedChunk(nullptr)
+{
+}
+
+Chunk *LightEngine::chunkAt(int x, int y, int z, int &localX, int &localY, int &localZ)
+{
+    ChunkPos pos = fromWorldPos(x, y, z);
+    if (cachedChunk == nullptr || pos != cachedPos)
+    {
+        auto it = chunks.find(pos);
+        if (it == chunks.end())
+            return nullptr;
+        cachedPos = pos;
+        cachedChunk = it->second;
+    }
+    localX = x - getX(pos) * CHUNK_SIZE;
+    localY = y - getY(pos) * CHUNK_SIZE;
+    localZ = z - getZ(pos) * CHUNK_SIZE;
+    return cachedChunk;
+}
+
+int LightEngine::getLight(int x, int y, int z, LightChannel channel)
+{
+    int localX, localY, localZ;
+    Chunk *chunk = chunkAt(x, y, z, localX, localY, localZ);
+    return chunk == nullptr ? -1 : chunk->getLight(localX, localY, localZ, channel);
+}
+
+void LightEngine::setLight(int x, int y, int z, LightChannel channel, int level)
+{
+    int localX, localY, localZ;
+    Chunk *chunk = chunkAt(x, y, z, localX, localY, localZ);
+    if (chunk == nullptr)
+        return;
+    chunk->setLight(localX, localY, localZ, channel, level);
+
+    // The faces of the neighboring chunks also sample the voxels on the border
+    ChunkPos pos = chunk->getPos();
+    changedChunks.insert(pos);
+    if (localX == 0 || localX == CHUNK_SIZE - 1)
+        changedChunks.insert(pos + ChunkPos(localX == 0 ? -1 : 1, 0, 0));
+    if (localY == 0 || localY == CHUNK_SIZE - 1)
+        changedChunks.insert(pos + ChunkPos(0, localY == 0 ? -1 : 1, 0));
+    if (localZ == 0 || localZ == CHUNK_SIZE - 1)
+        changedChunks.insert(pos + ChunkPos(0, 0, localZ == 0 ? -1 : 1));
+}
+
+bool LightEngine::isOpaque(int x, int y, int z)
+{
+    int localX, localY, localZ;
+    Chunk *chunk = chunkAt(x, y, z, localX, localY, localZ);
+    return chunk == nullptr || chunk->getVoxel(localX, localY, localZ) != Voxel::Air;
+}
+
+void LightEngine::queueAdd(int x, int y, int z, LightChannel channel)
+{
+    if (getLight(x, y, z, channel) > 0)
+        addQueues[channel].push({x, y, z, 0});
+}
+
+void LightEngine::queueRemove(int x, int y, int z, LightChannel channel)
+{
+    int level = getLight(x, y, z, channel);
+    if (level <= 0)
+        return;
+    setLight(x, y, z, channel, 0);
+    removeQueues[channel].push({x, y, z, level});
+}
+
+void LightEngine::propagate()
+{
+    for (LightChannel channel : {LightChannel::SkyLight, LightChannel::BlockLight})
+    {
+        unspread(channel);
+        spread(channel);
+    }
+}
+
+void LightEngine::unspread(LightChannel channel)
+{
+    std::queue<Node> &queue = removeQueues[channel];
+    while (!queue.empty())
+    {
+        Node node = queue.front();
+        queue.pop();
+        for (int n = 0; n < 6; n++)
+        {
+            int x = node.x + neighborOffsets[n][0], y = node.y + neighborOffsets[n][1], z = node.z + neighborOffsets[n][2];
+            int level = getLight(x, y, z, channel);
+            if (level <= 0)
+                continue;
+            // The light of the emitters is their own
+            bool emitter = isOpaque(x, y, z);
+            bool fellFromRemoved = channel == LightChannel::SkyLight && n == DOWN && node.level == MAX_LIGHT_LEVEL;
+            if (!emitter && (level < node.level || fellFromRemoved))
+            {
+                setLight(x, y, z, channel, 0);
+                queue.push({x, y, z, level});
+            }
+            else
+            {
+                // Lit by something else, it fills the emptied area again
+                addQueues[channel].push({x, y, z, 0});
+            }
+        }
+    }
+}
+
+void LightEngine::spread(LightChannel channel)
+{
+    std::queue<Node> &queue = addQueues[channel];
+    while (!queue.empty())
+    {
+        Node node = queue.front();
+        queue.pop();
+        // Read the level again, it may have changed since the voxel was queued
+        int level = getLight(node.x, node.y, node.z, channel);
+        if (level <= 0)
+            continue;
+        for (int n = 0; n < 6; n++)
+        {
+            int x = node.x + neighborOffsets[n][0], y = node.y + neighborOffsets[n][1], z = node.z + neighborOffsets[n][2];
+            if (isOpaque(x, y, z))
+                continue;
+            bool falls = channel == LightChannel::SkyLight && n == DOWN && level == MAX_LIGHT_LEVEL;
+            int nextLevel = falls ? level : level - 1;
+            if (nextLevel > getLight(x, y, z, channel))
+            {
+                setLight(x, y, z, channel, nextLevel);
+                queue.push({x, y, z, 0});
+            }
+        }
+    }
+}
+
+void LightEngine::reconcileSky(Chunk *lower, Chunk *upper)
+{
+    glm::ivec3 lowerOrigin(toWorldPos(lower->getPos()));
+    for (int x = 0; x < CHUNK_SIZE; x++)
+    {
+        for (int z = 0; z < CHUNK_SIZE; z++)
+        {
+            if (lower->getLight(x, CHUNK_SIZE - 1, z, LightChannel::SkyLight) != MAX_LIGHT_LEVEL ||
+                upper->getLight(x, 0, z, LightChannel::SkyLight) == MAX_LIGHT_LEVEL)
+                continue;
+            if (lower->getVoxel(x, CHUNK_SIZE - 1, z) != Voxel::Air)
+                continue;
+            // Removing the top of the column also removes what fell below it
+            queueRemove(lowerOrigin.x + x, lowerOrigin.y + CHUNK_SIZE - 1, lowerOrigin.z + z, LightChannel::SkyLight);
+        }
+    }
+}
+
+void LightEngine::connect(Chunk *chunk)
+{
+    cachedChunk = nullptr;
+    ChunkPos pos = chunk->getPos();
+
+    // calculateLight assumed the sky was open above every chunk
+    auto upper = chunks.find(pos + ChunkPos(0, 1, 0));
+    if (upper != chunks.end())
+        reconcileSky(chunk, upper->second);
+    auto lower = chunks.find(pos + ChunkPos(0, -1, 0));
+    if (lower != chunks.end())
+        reconcileSky(lower->second, chunk);
+
+    // Both sides of every shared face light each other
+    glm::ivec3 origin(toWorldPos(pos));
+    for (int n = 0; n < 6; n++)
+    {
+        glm::ivec3 offset(neighborOffsets[n][0], neighborOffsets[n][1], neighborOffsets[n][2]);
+        if (chunks.find(pos + ChunkPos(offset.x, offset.y, offset.z)) == chunks.end())
+            continue;
+
+        // The normal axis is the non-zero one, the face spans the two others
+        int axis = offset.x != 0 ? 0 : offset.y != 0 ? 1 : 2;
+        int uAxis = (axis + 1) % 3, vAxis = (axis + 2) % 3;
+        // The layer inside the chunk, then the one in the neighbor, so that the lookups stay in one chunk
+        for (int layer = 0; layer < 2; layer++)
+        {
+            for (int u = 0; u < CHUNK_SIZE; u++)
+            {
+                for (int v = 0; v < CHUNK_SIZE; v++)
+                {
+                    glm::ivec3 voxel = origin;
+                    voxel[axis] += offset[axis] > 0 ? CHUNK_SIZE - 1 : 0;
+                    voxel[uAxis] += u;
+                    voxel[vAxis] += v;
+                    voxel += offset * layer;
+                    queueAdd(voxel.x, voxel.y, voxel.z, LightChannel::SkyLight);
+                    queueAdd(voxel.x, voxel.y, voxel.z, LightChannel::BlockLight);
+                }
+            }
+        }
+    }
+
+    propagate();
+}
+
+void LightEngine::voxelChanged(int x, int y, int z, Voxel before)
+{
+    cachedChunk = nullptr;
+    queueChange(x, y, z, before);
+    propagate();
+}
+
+void LightEngine::voxelsChanged(const std::vector<VoxelChange> &changes)
+{
+    cachedChunk = nullptr;
+    for (const VoxelChange &change : changes)
+        queueChange(change.x, change.y, change.z, change.before);
+    propagate();
+}
+
+void LightEngine::queueChange(int x, int y, int z, Voxel before)
+{
+    int localX, localY, localZ;
+    Chunk *chunk = chunkAt(x, y, z, localX, localY, localZ);
+    if (chunk == nullptr)
+        return;
+    Voxel after = chunk->getVoxel(localX, localY, localZ);
+
+    // Whatever lit this voxel before is gone, the removal queues the neighbors that can light it again
+    queueRemove(x, y, z, LightChannel::SkyLight);
+    queueRemove(x, y, z, LightChannel::BlockLight);
+
+    // A new opening lets the light of the neighbors in
+    if (after == Voxel::Air && before != Voxel::Air)
+    {
+        for (int n = 0; n < 6; n++)
+        {
+            for (LightChannel channel : {LightChannel::SkyLight, LightChannel::BlockLight})
+                queueAdd(x + neighborOffsets[n][0], y + neighborOffsets[n][1], z + neighborOffsets[n][2], channel);
+        }
+    }
+
+    int emission = voxelEmission(after);
+    if (emission > 0)
+    {
+        setLight(x, y, z, LightChannel::BlockLight, emission);
+        addQueues[LightChannel::BlockLight].push({x, y, z, 0});
+    }
+}
+
+void LightEngine::takeChangedChunks(std::vector<ChunkPos> &changed)
+{
+    changed.assign(changedChunks.begin(), changedChunks.end());
+    changedChunks.clear();
+}
+
+LightWorkers::LightWorkers() : batch(nullptr), generation(0), next(0), busyWorkers(0), stopping(false)
+{
+    for (int i = 1; i < LIGHT_THREADS; i++)
+        threads.emplace_back(&LightWorkers::run, this);
+}
+
+LightWorkers::~LightWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+void LightWorkers::run()
+{
+    profiler::setThreadName("Light worker");
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        wake.wait(lock, [&]()
+                  { return stopping || (batch != nullptr && generation != seen); });
+        if (stopping)
+            return;
+        seen = generation;
+        busyWorkers++;
+        lock.unlock();
+        work();
+        lock.lock();
+        if (--busyWorkers == 0)
+            done.notify_one();
+    }
+}
+
+void LightWorkers::work()
+{
+    for (size_t i = next++; i < batch->size(); i = next++)
+        (*batch)[i]->calculateLight();
+}
+
+void LightWorkers::light(const std::vector<Chunk *> &chunks)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batch = &chunks;
+        next = 0;
+        generation++;
+    }
+    // A single chunk is not worth waking anyone
+    if (chunks.size() > 1)
+        wake.notify_all();
+    work();
+
+    // The workers that joined may still be on their last chunk, the ones that did not will skip this batch
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&]()
+              { return busyWorkers == 0; });
+    batch = nullptr;
+}
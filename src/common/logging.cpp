@@ -1,16 +1,235 @@
 #include "testgl/logging.hpp"
 #include <cstdarg>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#define LOG_QUEUE_SIZE 1024     // in messages, must be a power of two
+#define LOG_MESSAGE_SIZE 512    // in bytes, longer messages are truncated
+#define LOG_RATE_LIMIT 20       // messages per second and per call site, errors are never limited
+#define LOG_CALL_SITES 4096     // size of the rate limiting table, must be a power of two, the sites past it are not limited
+#define LOG_WRITER_SLEEP_MS 2   // how long the writer sleeps when the queue is empty
 
 namespace logging_utils
 {
+    namespace
+    {
+        // Bounded multi-producer multi-consumer ring buffer (Dmitry Vyukov's queue)
+        // Producers never wait: when the ring is full the message is dropped and counted
+        struct Slot
+        {
+            std::atomic<size_t> sequence;
+            FILE *stream;
+            char text[LOG_MESSAGE_SIZE];
+        };
+
+        Slot ring[LOG_QUEUE_SIZE];
+        std::atomic<size_t> enqueuePos(0);
+        std::atomic<size_t> dequeuePos(0);
+        std::atomic<uint64_t> droppedMessages(0);
+
+        // Rate limiting state of one call site, claimed by its first message
+        struct CallSite
+        {
+            std::atomic<const char *> file;
+            std::atomic<int> line; // 0 while free, -1 while being claimed
+            // The current second (high 32 bits) and the number of messages in it (low 32 bits)
+            std::atomic<uint64_t> state;
+        };
+        CallSite callSites[LOG_CALL_SITES];
+
+        const auto startTime = std::chrono::steady_clock::now();
+
+        std::atomic<int> nextThreadId(1);
+        thread_local int threadId = 0;
+
+        // Pop one message and write it, returns false if the queue is empty
+        bool writeOne()
+        {
+            size_t pos = dequeuePos.load(std::memory_order_relaxed);
+            Slot *slot;
+            for (;;)
+            {
+                slot = &ring[pos & (LOG_QUEUE_SIZE - 1)];
+                size_t sequence = slot->sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+                if (diff == 0)
+                {
+                    if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                    return false; // Empty
+                else
+                    pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+
+            fputs(slot->text, slot->stream);
+            slot->sequence.store(pos + LOG_QUEUE_SIZE, std::memory_order_release);
+            return true;
+        }
+
+        void drain()
+        {
+            while (writeOne())
+                ;
+            uint64_t dropped = droppedMessages.exchange(0, std::memory_order_relaxed);
+            if (dropped)
+                fprintf(stderr, "%s[W] logging: %lu messages dropped, the queue was full%s\n", yellow.c_str(), (unsigned long)dropped, reset.c_str());
+            fflush(stdout);
+            fflush(stderr);
+        }
+
+        // Owns the background thread that writes the messages
+        // Before it is constructed and after it is destroyed, messages are written synchronously
+        struct Writer
+        {
+            std::thread thread;
+            std::atomic<bool> running;
+
+            Writer()
+            {
+                for (size_t i = 0; i < LOG_QUEUE_SIZE; i++)
+                    ring[i].sequence.store(i, std::memory_order_relaxed);
+                running.store(true, std::memory_order_release);
+                thread = std::thread([this]()
+                                     {
+                                         while (running.load(std::memory_order_acquire))
+                                         {
+                                             if (!writeOne())
+                                             {
+                                                 drain();
+                                                 std::this_thread::sleep_for(std::chrono::milliseconds(LOG_WRITER_SLEEP_MS));
+                                             }
+                                         } });
+            }
+
+            ~Writer()
+            {
+                running.store(false, std::memory_order_release);
+                if (thread.joinable())
+                    thread.join();
+                drain();
+            }
+        } writer;
+
+        // Open addressing on the file and the line, so that two call sites never share an entry
+        // Returns nullptr if the table is full
+        CallSite *findCallSite(const char *file, int line)
+        {
+            size_t hash = (uintptr_t)file * 31 + line;
+            for (size_t i = 0; i < LOG_CALL_SITES; i++)
+            {
+                CallSite &site = callSites[(hash + i) & (LOG_CALL_SITES - 1)];
+                int siteLine = site.line.load(std::memory_order_acquire);
+                if (siteLine == 0)
+                {
+                    if (site.line.compare_exchange_strong(siteLine, -1, std::memory_order_acquire))
+                    {
+                        site.file.store(file, std::memory_order_relaxed);
+                        site.line.store(line, std::memory_order_release);
+                        return &site;
+                    }
+                    // Lost the claim, siteLine is now what the other thread wrote
+                }
+                // Being claimed by another thread, its call site is known right after
+                while (siteLine == -1)
+                    siteLine = site.line.load(std::memory_order_acquire);
+                if (siteLine == line && site.file.load(std::memory_order_relaxed) == file)
+                    return &site;
+            }
+            return nullptr;
+        }
+
+        // Returns the number of messages suppressed during the previous second, or -1 if this one must be suppressed too
+        int64_t rateLimit(const char *file, int line)
+        {
+            CallSite *site = findCallSite(file, line);
+            if (site == nullptr)
+                return 0;
+            uint64_t second = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - startTime).count();
+
+            uint64_t state = site->state.load(std::memory_order_relaxed);
+            if ((state >> 32) != second)
+            {
+                // New second, whoever wins the exchange reports the suppressed messages
+                if (site->state.compare_exchange_strong(state, (second << 32) | 1, std::memory_order_relaxed))
+                {
+                    uint32_t count = state & 0xFFFFFFFF;
+                    return count > LOG_RATE_LIMIT ? count - LOG_RATE_LIMIT : 0;
+                }
+            }
+            uint32_t count = site->state.fetch_add(1, std::memory_order_relaxed) & 0xFFFFFFFF;
+            return count < LOG_RATE_LIMIT ? 0 : -1;
+        }
+
+        // Format `[L] time T<thread> file:line: message` into `destination`
+        void format(char *destination, const char *color, char tag, const char *file, int line, int64_t suppressed, const char *fmt, va_list args)
+        {
+            if (threadId == 0)
+                threadId = nextThreadId++;
+            float time = std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime).count();
+
+            int size = LOG_MESSAGE_SIZE - (int)reset.size() - 2; // Keep room for the reset code and the newline
+            int written = snprintf(destination, size, "%s[%c] %9.3f T%d %s:%d: ", color, tag, time, threadId, file, line);
+            if (written < size)
+                written += vsnprintf(destination + written, size - written, fmt, args);
+            if (suppressed > 0 && written < size)
+                written += snprintf(destination + written, size - written, " (%ld similar messages suppressed)", (long)suppressed);
+            if (written >= size)
+                written = size - 1;
+            snprintf(destination + written, LOG_MESSAGE_SIZE - written, "%s\n", reset.c_str());
+        }
+
+        // The errors and fatal errors are not `limited`, none of them is suppressed
+        void log(FILE *stream, const char *color, char tag, bool limited, const char *file, int line, const char *fmt, va_list args)
+        {
+            int64_t suppressed = limited ? rateLimit(file, line) : 0;
+            if (suppressed < 0)
+                return;
+
+            if (!writer.running.load(std::memory_order_acquire))
+            {
+                char text[LOG_MESSAGE_SIZE];
+                format(text, color, tag, file, line, suppressed, fmt, args);
+                fputs(text, stream);
+                return;
+            }
+
+            // Claim a slot
+            size_t pos = enqueuePos.load(std::memory_order_relaxed);
+            Slot *slot;
+            for (;;)
+            {
+                slot = &ring[pos & (LOG_QUEUE_SIZE - 1)];
+                size_t sequence = slot->sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+                if (diff == 0)
+                {
+                    if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                {
+                    droppedMessages.fetch_add(1, std::memory_order_relaxed); // Full, never block the caller
+                    return;
+                }
+                else
+                    pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+
+            format(slot->text, color, tag, file, line, suppressed, fmt, args);
+            slot->stream = stream;
+            slot->sequence.store(pos + 1, std::memory_order_release);
+        }
+    } // namespace
 
     void info(const char *file, int line, const char *fmt, ...)
     {
         va_list args;
         va_start(args, fmt);
-        fprintf(stdout, "%s[I] %s:%d: ", green.c_str(), file, line);
-        vfprintf(stdout, fmt, args);
-        fprintf(stdout, "%s\n", reset.c_str());
+        log(stdout, green.c_str(), 'I', true, file, line, fmt, args);
         va_end(args);
     }
 
@@ -18,9 +237,7 @@ namespace logging_utils
     {
         va_list args;
         va_start(args, fmt);
-        fprintf(stdout, "%s[W] %s:%d: ", yellow.c_str(), file, line);
-        vfprintf(stdout, fmt, args);
-        fprintf(stdout, "%s\n", reset.c_str());
+        log(stdout, yellow.c_str(), 'W', true, file, line, fmt, args);
         va_end(args);
     }
 
@@ -28,9 +245,7 @@ namespace logging_utils
     {
         va_list args;
         va_start(args, fmt);
-        fprintf(stderr, "%s[E] %s:%d: ", red.c_str(), file, line);
-        vfprintf(stderr, fmt, args);
-        fprintf(stderr, "%s\n", reset.c_str());
+        log(stderr, red.c_str(), 'E', false, file, line, fmt, args);
         va_end(args);
     }
 
@@ -38,10 +253,10 @@ namespace logging_utils
     {
         va_list args;
         va_start(args, fmt);
-        fprintf(stderr, "%s[F] %s:%d: ", magenta.c_str(), file, line);
-        vfprintf(stderr, fmt, args);
-        fprintf(stderr, "%s\n", reset.c_str());
+        log(stderr, magenta.c_str(), 'F', false, file, line, fmt, args);
         va_end(args);
+        // Make sure the message is out before leaving
+        flush();
         exit(EXIT_FAILURE);
     }
 
@@ -52,10 +267,13 @@ namespace logging_utils
 #endif
         va_list args;
         va_start(args, fmt);
-        fprintf(stdout, "%s[D] %s:%d: ", cyan.c_str(), file, line);
-        vfprintf(stdout, fmt, args);
-        fprintf(stdout, "%s\n", reset.c_str());
+        log(stdout, cyan.c_str(), 'D', true, file, line, fmt, args);
         va_end(args);
     }
 
-}
\ No newline at end of file
+    void flush()
+    {
+        drain();
+    }
+
+}
@@ -0,0 +1,129 @@
+#include "testgl/occlusion.hpp"
+#include "testgl/chunk.hpp"
+#include "testgl/chunkpos.hpp"
+#include "testgl/frameuniforms.hpp"
+
+#define OCCLUSION_BOX_MARGIN 1.0f // in voxels, chunks whose box is closer than this to the camera are always drawn
+
+bool OcclusionCuller::enabled = OCCLUSION_CULLING;
+
+// Unit cube, drawn from both sides so that it works even if the camera is inside
+static const float cubeVertices[] = {
+    0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 0, 0, 1, // front
+    0, 0, 0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 0, 0, 0, 1, 0, // back
+    0, 1, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, // left
+    1, 1, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1, 1, 1, 1, 0, 1, // right
+    0, 1, 0, 1, 1, 1, 1, 1, 0, 1, 1, 1, 0, 1, 0, 0, 1, 1, // top
+    0, 0, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0, 0, 1, 0, 0, 0, // bottom
+};
+
+OcclusionCuller::OcclusionCuller() : shader("../shaders/occlusion.vert", "../shaders/occlusion.frag"),
+                                     occludedChunks(0), occludedVertices(0), testedChunks(0), frame(0)
+{
+    FrameUniforms::attach(&shader);
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
+
+    // Position attribute
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+    glEnableVertexAttribArray(0);
+
+    glBindVertexArray(0);
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+}
+
+void OcclusionCuller::beginFrame()
+{
+    occludedChunks = 0;
+    occludedVertices = 0;
+    testedChunks = 0;
+    frame++;
+}
+
+void OcclusionCuller::draw(Chunk *chunk, Shader *chunkShader, glm::vec3 cameraPosition)
+{
+    if (!enabled)
+    {
+        chunk->draw(chunkShader, cameraPosition);
+        return;
+    }
+
+    if (!chunk->isDrawable())
+        return;
+
+    glm::vec3 origin = ChunkPosTools::toWorldPos(chunk->getPos());
+    glm::vec3 boxMin = origin + chunk->getDrawBoundsMin();
+    glm::vec3 boxMax = origin + chunk->getDrawBoundsMax();
+
+    // The box would be clipped by the near plane, or its far side hidden by the chunks behind the camera
+    glm::vec3 nearMin = boxMin - OCCLUSION_BOX_MARGIN, nearMax = boxMax + OCCLUSION_BOX_MARGIN;
+    if (cameraPosition.x > nearMin.x && cameraPosition.y > nearMin.y && cameraPosition.z > nearMin.z &&
+        cameraPosition.x < nearMax.x && cameraPosition.y < nearMax.y && cameraPosition.z < nearMax.z)
+    {
+        chunk->draw(chunkShader, cameraPosition);
+        return;
+    }
+
+    // The query of the previous frame decides, this frame's one is issued for the next frame
+    int slot = frame & 1;
+    unsigned int query = chunk->getOcclusionQuery(slot);
+    unsigned int previousQuery = chunk->getOcclusionQuery(slot ^ 1);
+    bool previousIssued = chunk->getOcclusionQueryFrame(slot ^ 1) == frame - 1;
+
+    // Statistics: the result of the previous frame is ready by now most of the time, never wait for it
+    if (previousIssued)
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(previousQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            GLuint visible = 0;
+            glGetQueryObjectuiv(previousQuery, GL_QUERY_RESULT, &visible);
+            testedChunks++;
+            if (!visible)
+            {
+                occludedChunks++;
+                occludedVertices += chunk->getDrawSize();
+            }
+        }
+    }
+
+    // Rasterize the box without touching the framebuffer
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    glDisable(GL_CULL_FACE);
+
+    shader.use();
+    shader.setVec3("boxMin", boxMin);
+    shader.setVec3("boxMax", boxMax);
+    glBeginQuery(GL_ANY_SAMPLES_PASSED, query);
+    glBindVertexArray(VAO);
+    glDrawArrays(GL_TRIANGLES, 0, 36);
+    glEndQuery(GL_ANY_SAMPLES_PASSED);
+    chunk->setOcclusionQueryFrame(slot, frame);
+
+    glEnable(GL_CULL_FACE);
+    glDepthMask(GL_TRUE);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+    // A chunk that was not tested in the previous frame is drawn, it has no result to go by
+    if (!previousIssued)
+    {
+        chunk->draw(chunkShader, cameraPosition);
+        return;
+    }
+    // Neither the GPU nor the CPU waits, the chunk is drawn if the result is not there yet
+    glBeginConditionalRender(previousQuery, GL_QUERY_NO_WAIT);
+    chunk->draw(chunkShader, cameraPosition);
+    glEndConditionalRender();
+}
@@ -0,0 +1,124 @@
+#include "testgl/overlay.hpp"
+#include "testgl/constants.hpp"
+
+#define OVERLAY_WIDTH 0.9f   // in NDC
+#define OVERLAY_HEIGHT 0.5f  // in NDC
+#define OVERLAY_SCALE 33.34f // frame time in ms that fills the whole height
+
+// One color per profiler::Stage
+static const float stageColors[profiler::STAGE_COUNT][3] = {
+    {0.6f, 0.2f, 0.2f}, // TickDelete
+    {0.9f, 0.6f, 0.1f}, // TickLoad
+    {0.9f, 0.9f, 0.2f}, // TickOcclusion
+    {0.3f, 0.8f, 0.3f}, // TickMesh
+    {1.0f, 0.0f, 1.0f}, // LockWait
+    {0.5f, 0.5f, 0.9f}, // Discard
+    {0.2f, 0.8f, 0.9f}, // Upload
+    {0.3f, 0.3f, 0.5f}, // Shadows
+    {0.6f, 0.6f, 0.6f}, // Prepass
+    {0.9f, 0.3f, 0.3f}, // Draw
+    {1.0f, 0.9f, 0.6f}, // Lighting
+    {0.4f, 0.7f, 0.4f}, // Terrain
+};
+static const float frameColor[3] = {0.25f, 0.25f, 0.25f};
+static const float targetColor[3] = {1.0f, 1.0f, 1.0f};
+
+Overlay::Overlay() : shader("../shaders/overlay.vert", "../shaders/overlay.frag")
+{
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+    // Position attribute
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)0);
+    glEnableVertexAttribArray(0);
+
+    // Color attribute
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    glBindVertexArray(0);
+}
+
+Overlay::~Overlay()
+{
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+}
+
+void Overlay::addRect(float x0, float y0, float x1, float y1, const float color[3])
+{
+    const float corners[6][2] = {{x0, y0}, {x1, y0}, {x1, y1}, {x1, y1}, {x0, y1}, {x0, y0}};
+    for (int i = 0; i < 6; i++)
+    {
+        vertices.push_back(corners[i][0]);
+        vertices.push_back(corners[i][1]);
+        vertices.insert(vertices.end(), color, color + 3);
+    }
+}
+
+void Overlay::draw()
+{
+    if (!profiler::enabled)
+        return;
+
+    vertices.clear();
+
+    const float left = -0.95f, bottom = -0.95f;
+    const float slot = OVERLAY_WIDTH / PROFILER_HISTORY;
+    const float msToNDC = OVERLAY_HEIGHT / OVERLAY_SCALE;
+
+    // Oldest frame on the left
+    for (int i = 0; i < PROFILER_HISTORY; i++)
+    {
+        const profiler::FrameStats &stats = profiler::getFrameStats(PROFILER_HISTORY - 1 - i);
+        float x = left + i * slot;
+
+        // Main thread: whole frame in the background, measured stages on top
+        float y = bottom;
+        addRect(x, y, x + slot / 3, y + std::min(stats.frame, OVERLAY_SCALE) * msToNDC, frameColor);
+        for (int stage = profiler::LockWait; stage < profiler::STAGE_COUNT; stage++)
+        {
+            float height = stats.cpu[stage] * msToNDC;
+            addRect(x, y, x + slot / 3, y + height, stageColors[stage]);
+            y += height;
+        }
+
+        // GPU
+        y = bottom;
+        for (int stage = profiler::Upload; stage < profiler::STAGE_COUNT; stage++)
+        {
+            float height = stats.gpu[stage] * msToNDC;
+            addRect(x + slot / 3, y, x + 2 * slot / 3, y + height, stageColors[stage]);
+            y += height;
+        }
+
+        // Tick thread
+        y = bottom;
+        for (int stage = profiler::TickDelete; stage < profiler::LockWait; stage++)
+        {
+            float height = stats.cpu[stage] * msToNDC;
+            addRect(x + 2 * slot / 3, y, x + slot, y + height, stageColors[stage]);
+            y += height;
+        }
+    }
+
+    // 60 FPS target line
+    float target = bottom + 1000.0f / 60.0f * msToNDC;
+    addRect(left, target, left + OVERLAY_WIDTH, target + 0.004f, targetColor);
+
+    // Draw over the scene, whatever the current polygon mode is
+    glDisable(GL_DEPTH_TEST);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    shader.use();
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STREAM_DRAW);
+    glDrawArrays(GL_TRIANGLES, 0, vertices.size() / 5);
+    glBindVertexArray(0);
+
+    glEnable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,153 @@
+#include "testgl/pacing.hpp"
+#include "testgl/logging.hpp"
+
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#define PACING_SPIN_TIME std::chrono::microseconds(500) // the end of the wait is spent spinning, sleeps overshoot
+
+FramePacer::Mode FramePacer::mode = (FramePacer::Mode)PACING_MODE;
+const char *FramePacer::modeNames[MODE_COUNT] = {"vsync", "capped", "uncapped"};
+
+void FramePacer::cycleMode()
+{
+    mode = (Mode)((mode + 1) % MODE_COUNT);
+    log_info("Frame pacing: %s", modeNames[mode]);
+}
+
+FramePacer::FramePacer() : frames(), frame(0), appliedMode(MODE_COUNT), deadline(clock::now()),
+                           frameStart(clock::now()), inputTime(clock::now()), stats()
+{
+    for (InFlight &inFlight : frames)
+        glGenQueries(1, &inFlight.endQuery);
+    applyMode();
+}
+
+FramePacer::~FramePacer()
+{
+    for (InFlight &inFlight : frames)
+    {
+        if (inFlight.fence != nullptr)
+            glDeleteSync(inFlight.fence);
+        glDeleteQueries(1, &inFlight.endQuery);
+    }
+}
+
+void FramePacer::applyMode()
+{
+    if (appliedMode == mode)
+        return;
+    appliedMode = mode;
+    glfwSwapInterval(mode == VSync ? 1 : 0);
+    deadline = clock::now();
+}
+
+bool FramePacer::retire(InFlight &inFlight, GLuint64 timeout)
+{
+    if (inFlight.fence == nullptr)
+        return true;
+    GLenum result = glClientWaitSync(inFlight.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    if (result == GL_TIMEOUT_EXPIRED)
+        return false;
+
+    // The frame may have ended long before it is collected here, its end is read from the GPU clock instead
+    GLuint64 endTime;
+    glGetQueryObjectui64v(inFlight.endQuery, GL_QUERY_RESULT, &endTime);
+    clock::time_point end = inFlight.cpuTime + std::chrono::duration_cast<clock::duration>(
+                                                   std::chrono::nanoseconds((GLint64)endTime - inFlight.gpuTime));
+    double latency = std::chrono::duration<double>(end - inFlight.inputTime).count();
+    Stats &current = stats[appliedMode];
+    current.latencies++;
+    current.latency += latency;
+    current.maxLatency = std::max(current.maxLatency, latency);
+
+    glDeleteSync(inFlight.fence);
+    inFlight.fence = nullptr;
+    return true;
+}
+
+void FramePacer::beginFrame()
+{
+    applyMode();
+
+    // Collect the frames that are already done, oldest first, so that their latency is not overestimated
+    for (int i = 0; i < PACING_MAX_FRAMES_IN_FLIGHT; i++)
+        if (!retire(frames[(frame + i) % PACING_MAX_FRAMES_IN_FLIGHT], 0))
+            break;
+
+    // Do not queue more frames than PACING_MAX_FRAMES_IN_FLIGHT, the input of a queued frame gets old
+    retire(frames[frame % PACING_MAX_FRAMES_IN_FLIGHT], GL_TIMEOUT_IGNORED);
+
+    if (mode == Capped)
+    {
+        clock::duration period = std::chrono::duration_cast<clock::duration>(std::chrono::seconds(1)) / PACING_TARGET_FPS;
+        deadline += period;
+        clock::time_point now = clock::now();
+        if (deadline < now - period)
+            deadline = now; // Too late to catch up, start again from now
+        std::this_thread::sleep_until(deadline - PACING_SPIN_TIME);
+        while (clock::now() < deadline)
+            std::this_thread::yield();
+    }
+
+    clock::time_point now = clock::now();
+    double interval = std::chrono::duration<double>(now - frameStart).count();
+    frameStart = now;
+    Stats &current = stats[appliedMode];
+    current.frames++;
+    current.interval += interval;
+    current.intervalSquared += interval * interval;
+}
+
+void FramePacer::endFrame()
+{
+    InFlight &inFlight = frames[frame % PACING_MAX_FRAMES_IN_FLIGHT];
+    glQueryCounter(inFlight.endQuery, GL_TIMESTAMP);
+    inFlight.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    inFlight.inputTime = inputTime;
+    // Does not wait for the GPU, both clocks are read at the same moment
+    glGetInteger64v(GL_TIMESTAMP, &inFlight.gpuTime);
+    inFlight.cpuTime = clock::now();
+    frame++;
+}
+
+float FramePacer::getAverageLatency(Mode mode)
+{
+    const Stats &current = stats[mode];
+    return current.latencies ? current.latency / current.latencies * 1000.0f : 0.0f;
+}
+
+float FramePacer::getMaxLatency(Mode mode)
+{
+    return stats[mode].maxLatency * 1000.0f;
+}
+
+float FramePacer::getAverageFrameTime(Mode mode)
+{
+    const Stats &current = stats[mode];
+    return current.frames ? current.interval / current.frames * 1000.0f : 0.0f;
+}
+
+float FramePacer::getJitter(Mode mode)
+{
+    const Stats &current = stats[mode];
+    if (current.frames < 2)
+        return 0.0f;
+    double mean = current.interval / current.frames;
+    double variance = current.intervalSquared / current.frames - mean * mean;
+    return std::sqrt(std::max(variance, 0.0)) * 1000.0f;
+}
+
+void FramePacer::report()
+{
+    for (int i = 0; i < MODE_COUNT; i++)
+    {
+        if (stats[i].frames == 0)
+            continue;
+        Mode mode = (Mode)i;
+        log_info("Pacing %-8s %6d frames, input to present %.2fms avg %.2fms max, frame time %.2fms +- %.2fms", modeNames[i],
+                 stats[i].frames, getAverageLatency(mode), getMaxLatency(mode), getAverageFrameTime(mode), getJitter(mode));
+    }
+}
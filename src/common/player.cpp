@@ -61,29 +61,34 @@ void Player::processKeyboard(GLFWwindow *window, float deltaTime)
         camera.ProcessKeyboard(direction, deltaTime);
 }
 
-void Player::setupCameraTransform(Shader *shader, uint screen_w,
-                                  uint screen_h)
+glm::mat4 Player::getProjectionMatrix(uint screen_w, uint screen_h)
 {
-    shader->use();
-    shader->setMat4("view", camera.GetViewMatrix());
-    shader->setMat4("projection", camera.GetProjectionMatrix(
-                                      screen_w, screen_h, 0.1f,
+    return camera.GetProjectionMatrix(screen_w, screen_h, 0.1f,
                                       // We use +3 because it would be 1 + sqrt(2) but no need for useless computation
-                                      (VIEW_DISTANCE + 3) * CHUNK_SIZE)); // View distance here
+                                      (VIEW_DISTANCE + 3) * CHUNK_SIZE); // View distance here
 }
 
 void Player::mouse_button_callback(int button, int action, int mods)
 {
-    // Place a block if the left mouse button is pressed
-    if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS)
-    {
-        glm::vec3 block_pos = camera.Position;
-    }
-    // Delete the block if the right mouse button is pressed
-    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
-    {
-        glm::vec3 block_pos = camera.Position;
-    }
+    if (action != GLFW_PRESS)
+        return;
+    // Break the voxel the camera looks at with the left button, place dirt against it with the right one
+    Voxel value;
+    if (button == GLFW_MOUSE_BUTTON_LEFT)
+        value = Voxel::Air;
+    else if (button == GLFW_MOUSE_BUTTON_RIGHT)
+        value = Voxel::Dirt;
+    else
+        return;
+    std::lock_guard<std::mutex> lock(picksMutex);
+    picks.push_back({camera.Position, camera.Front, value});
+}
+
+void Player::takePicks(std::vector<VoxelPick> &taken)
+{
+    std::lock_guard<std::mutex> lock(picksMutex);
+    taken.swap(picks);
+    picks.clear();
 }
 
 Player::~Player()
@@ -0,0 +1,69 @@
+#include "testgl/prepass.hpp"
+#include "testgl/chunk.hpp"
+#include "testgl/constants.hpp"
+#include "testgl/frameuniforms.hpp"
+
+bool DepthPrepass::enabled = DEPTH_PREPASS;
+
+DepthPrepass::DepthPrepass() : shader("../shaders/depth.vert", "../shaders/depth.frag"),
+                               pulledShader("../shaders/pulled.vert", "../shaders/depth.frag"),
+                               samplesQueryIssued(false), countingFragments(false), shadedFragments(0)
+{
+    FrameUniforms::attach(&shader);
+    FrameUniforms::attach(&pulledShader);
+    glGenQueries(1, &samplesQuery);
+}
+
+DepthPrepass::~DepthPrepass()
+{
+    glDeleteQueries(1, &samplesQuery);
+}
+
+void DepthPrepass::beginFrame()
+{
+    // Never wait for the GPU, keep the previous value if the result is not there yet
+    if (samplesQueryIssued)
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(samplesQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            glGetQueryObjectuiv(samplesQuery, GL_QUERY_RESULT, &shadedFragments);
+            samplesQueryIssued = false;
+        }
+    }
+}
+
+void DepthPrepass::draw(const std::vector<Chunk *> &chunks, glm::vec3 cameraPosition)
+{
+    if (!enabled)
+        return;
+
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    for (Chunk *chunk : chunks)
+        chunk->draw(chunk->isPulled() ? &pulledShader : &shader, cameraPosition);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+void DepthPrepass::beginShading(bool countFragments)
+{
+    // The material pass draws the same surfaces again, they must pass the depth test
+    if (enabled)
+        glDepthFunc(GL_LEQUAL);
+
+    countingFragments = countFragments && !samplesQueryIssued;
+    if (countingFragments)
+        glBeginQuery(GL_SAMPLES_PASSED, samplesQuery);
+}
+
+void DepthPrepass::endShading()
+{
+    if (countingFragments)
+    {
+        glEndQuery(GL_SAMPLES_PASSED);
+        samplesQueryIssued = true;
+        countingFragments = false;
+    }
+
+    glDepthFunc(GL_LESS);
+}
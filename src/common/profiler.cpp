@@ -0,0 +1,253 @@
+#include "testgl/profiler.hpp"
+#include "testgl/logging.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace profiler
+{
+    const char *stageNames[STAGE_COUNT] = {
+        "deleteChunks",
+        "loadChunks",
+        "updateSideOcclusion",
+        "updateMesh",
+        "chunksMutex wait",
+        "discardChunks",
+        "uploadMesh",
+        "shadowCascades",
+        "depthPrepass",
+        "draw",
+        "deferredLighting",
+        "farTerrain",
+    };
+
+    std::atomic<bool> enabled(false);
+
+    namespace
+    {
+        const auto startTime = std::chrono::steady_clock::now();
+
+        // CPU time spent in each stage since the last endFrame, in µs
+        std::atomic<uint64_t> cpuAccumulators[STAGE_COUNT];
+
+        FrameStats history[PROFILER_HISTORY];
+        int historyHead = 0;
+
+        // GPU queries, kept for PROFILER_GPU_LATENCY frames so that reading them never stalls
+        GLuint gpuQueries[PROFILER_GPU_LATENCY][STAGE_COUNT];
+        bool gpuIssued[PROFILER_GPU_LATENCY][STAGE_COUNT];
+        uint64_t gpuIssueTime[PROFILER_GPU_LATENCY][STAGE_COUNT];
+        bool gpuInitialized = false;
+        int gpuFrame = 0;
+        int gpuCurrentStage = -1;
+        float gpuAccumulators[STAGE_COUNT];
+
+        struct TraceEvent
+        {
+            const char *name;
+            int tid;
+            uint64_t start;
+            uint64_t duration;
+        };
+
+        // Protects everything related to the trace, except `tracing` which is read without it
+        std::mutex traceMutex;
+        std::atomic<bool> tracing(false);
+        std::vector<TraceEvent> traceEvents;
+        std::vector<std::pair<int, std::string>> threadNames;
+
+        // GPU spans are exported on their own track
+        const int GPU_TID = 0;
+
+        std::atomic<int> nextThreadId(1);
+        thread_local int threadId = 0;
+
+        int getThreadId()
+        {
+            if (threadId == 0)
+                threadId = nextThreadId++;
+            return threadId;
+        }
+
+        void addTraceEvent(const char *name, int tid, uint64_t start, uint64_t duration)
+        {
+            // Every profiled scope ends here, only take the lock while a capture is running
+            if (!tracing.load(std::memory_order_relaxed))
+                return;
+            std::lock_guard<std::mutex> lock(traceMutex);
+            if (!tracing)
+                return;
+            if (traceEvents.size() >= PROFILER_MAX_TRACE_EVENTS)
+            {
+                log_warn("Trace buffer full, stopping capture");
+                tracing = false;
+                return;
+            }
+            traceEvents.push_back({name, tid, start, duration});
+        }
+    } // namespace
+
+    void toggle()
+    {
+        enabled = !enabled;
+        log_info("Profiler %s", enabled ? "enabled" : "disabled");
+    }
+
+    uint64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    void setThreadName(const char *name)
+    {
+        std::lock_guard<std::mutex> lock(traceMutex);
+        threadNames.emplace_back(getThreadId(), name);
+    }
+
+    void record(Stage stage, uint64_t start, uint64_t end)
+    {
+        cpuAccumulators[stage].fetch_add(end - start, std::memory_order_relaxed);
+        addTraceEvent(stageNames[stage], getThreadId(), start, end - start);
+    }
+
+    void beginGpu(Stage stage)
+    {
+        if (!enabled.load(std::memory_order_relaxed))
+            return;
+        if (!gpuInitialized)
+        {
+            glGenQueries(PROFILER_GPU_LATENCY * STAGE_COUNT, &gpuQueries[0][0]);
+            gpuInitialized = true;
+        }
+        int slot = gpuFrame % PROFILER_GPU_LATENCY;
+        if (gpuCurrentStage != -1 || gpuIssued[slot][stage])
+            return; // Nested or issued twice in the same frame
+        glBeginQuery(GL_TIME_ELAPSED, gpuQueries[slot][stage]);
+        gpuIssued[slot][stage] = true;
+        gpuIssueTime[slot][stage] = now();
+        gpuCurrentStage = stage;
+    }
+
+    void endGpu()
+    {
+        if (gpuCurrentStage == -1)
+            return;
+        glEndQuery(GL_TIME_ELAPSED);
+        gpuCurrentStage = -1;
+    }
+
+    void beginFrame()
+    {
+        gpuFrame++;
+        if (!gpuInitialized)
+            return;
+
+        // The slot we are about to reuse was issued PROFILER_GPU_LATENCY frames ago
+        int slot = gpuFrame % PROFILER_GPU_LATENCY;
+        for (int stage = 0; stage < STAGE_COUNT; stage++)
+        {
+            if (!gpuIssued[slot][stage])
+                continue;
+            gpuIssued[slot][stage] = false;
+
+            GLint available = 0;
+            glGetQueryObjectiv(gpuQueries[slot][stage], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue; // Drop the sample rather than stalling the pipeline
+
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(gpuQueries[slot][stage], GL_QUERY_RESULT, &elapsed);
+            gpuAccumulators[stage] += elapsed / 1e6f;
+            // The GPU span is placed where it was issued, the real start is a bit later
+            addTraceEvent(stageNames[stage], GPU_TID, gpuIssueTime[slot][stage], elapsed / 1000);
+        }
+    }
+
+    void endFrame(float frameTime)
+    {
+        historyHead = (historyHead + 1) % PROFILER_HISTORY;
+        FrameStats &stats = history[historyHead];
+        stats.frame = frameTime * 1000.0f;
+        for (int stage = 0; stage < STAGE_COUNT; stage++)
+        {
+            stats.cpu[stage] = cpuAccumulators[stage].exchange(0, std::memory_order_relaxed) / 1000.0f;
+            stats.gpu[stage] = gpuAccumulators[stage];
+            gpuAccumulators[stage] = 0.0f;
+        }
+    }
+
+    const FrameStats &getFrameStats(int framesAgo)
+    {
+        return history[(historyHead - framesAgo % PROFILER_HISTORY + PROFILER_HISTORY) % PROFILER_HISTORY];
+    }
+
+    FrameStats getAverageStats(int count)
+    {
+        FrameStats average = {};
+        if (count > PROFILER_HISTORY)
+            count = PROFILER_HISTORY;
+        for (int i = 0; i < count; i++)
+        {
+            const FrameStats &stats = getFrameStats(i);
+            average.frame += stats.frame / count;
+            for (int stage = 0; stage < STAGE_COUNT; stage++)
+            {
+                average.cpu[stage] += stats.cpu[stage] / count;
+                average.gpu[stage] += stats.gpu[stage] / count;
+            }
+        }
+        return average;
+    }
+
+    bool isTracing()
+    {
+        return tracing;
+    }
+
+    void startTrace()
+    {
+        enabled = true;
+        std::lock_guard<std::mutex> lock(traceMutex);
+        traceEvents.clear();
+        tracing = true;
+        log_info("Trace capture started");
+    }
+
+    void stopTrace(const char *path)
+    {
+        std::lock_guard<std::mutex> lock(traceMutex);
+        tracing = false;
+
+        FILE *file = fopen(path, "w");
+        if (file == nullptr)
+        {
+            log_error("Could not open %s to write the trace", path);
+            return;
+        }
+
+        // https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"GPU\"}}", GPU_TID);
+        for (auto &[tid, name] : threadNames)
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", tid, name.c_str());
+        for (const TraceEvent &event : traceEvents)
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lu,\"dur\":%lu}",
+                    event.name, event.tid, (unsigned long)event.start, (unsigned long)event.duration);
+        fprintf(file, "\n]}\n");
+        fclose(file);
+
+        log_info("Trace with %d events written to %s", (int)traceEvents.size(), path);
+        traceEvents.clear();
+    }
+
+    void toggleTrace()
+    {
+        if (isTracing())
+            stopTrace(TRACE_OUTPUT_PATH);
+        else
+            startTrace();
+    }
+} // namespace profiler
@@ -0,0 +1,146 @@
+#include "testgl/resolution.hpp"
+#include "testgl/logging.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <glad/glad.h>
+
+bool DynamicResolution::enabled = DYNAMIC_RESOLUTION;
+
+DynamicResolution::DynamicResolution(int windowWidth, int windowHeight) : FBO(0), colorTexture(0), depthRenderbuffer(0),
+                                                                          windowWidth(windowWidth), windowHeight(windowHeight),
+                                                                          scale(RESOLUTION_MAX_SCALE), scaleLocked(false), issued(), frame(0),
+                                                                          gpuFrameTime(0.0f)
+{
+    glGenQueries(RESOLUTION_GPU_LATENCY * 2, &queries[0][0]);
+    createTargets();
+}
+
+DynamicResolution::~DynamicResolution()
+{
+    deleteTargets();
+    glDeleteQueries(RESOLUTION_GPU_LATENCY * 2, &queries[0][0]);
+}
+
+void DynamicResolution::createTargets()
+{
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+    glGenTextures(1, &colorTexture);
+    glBindTexture(GL_TEXTURE_2D, colorTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, getMaxWidth(), getMaxHeight(), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &depthRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, getMaxWidth(), getMaxHeight());
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        log_error("Dynamic resolution framebuffer is not complete");
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DynamicResolution::deleteTargets()
+{
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteTextures(1, &colorTexture);
+    glDeleteRenderbuffers(1, &depthRenderbuffer);
+    FBO = colorTexture = depthRenderbuffer = 0;
+}
+
+void DynamicResolution::resize(int windowWidth, int windowHeight)
+{
+    if (windowWidth == this->windowWidth && windowHeight == this->windowHeight)
+        return;
+    // Minimized windows have a 0x0 framebuffer
+    if (windowWidth <= 0 || windowHeight <= 0)
+        return;
+    this->windowWidth = windowWidth;
+    this->windowHeight = windowHeight;
+    deleteTargets();
+    createTargets();
+}
+
+int DynamicResolution::getWidth()
+{
+    return std::max(1, (int)(windowWidth * getScale()));
+}
+
+int DynamicResolution::getHeight()
+{
+    return std::max(1, (int)(windowHeight * getScale()));
+}
+
+void DynamicResolution::adjustScale()
+{
+    if (gpuFrameTime <= 0.0f)
+        return;
+
+    // Close enough to the target, keep the resolution stable
+    float ratio = RESOLUTION_TARGET_FRAME_TIME / gpuFrameTime;
+    if (std::abs(ratio - 1.0f) < RESOLUTION_TOLERANCE)
+        return;
+
+    // The cost is mostly proportional to the number of pixels, which grows with the square of the scale
+    float wanted = scale * std::sqrt(ratio);
+    scale += (wanted - scale) * RESOLUTION_ADJUST_RATE;
+    scale = std::clamp(scale, (float)RESOLUTION_MIN_SCALE, (float)RESOLUTION_MAX_SCALE);
+}
+
+void DynamicResolution::lockScale(float scale)
+{
+    this->scale = std::clamp(scale, (float)RESOLUTION_MIN_SCALE, (float)RESOLUTION_MAX_SCALE);
+    scaleLocked = true;
+}
+
+void DynamicResolution::beginFrame()
+{
+    // The slot we are about to reuse was issued RESOLUTION_GPU_LATENCY frames ago
+    int slot = frame % RESOLUTION_GPU_LATENCY;
+    if (issued[slot])
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            GLuint64 start = 0, end = 0;
+            glGetQueryObjectui64v(queries[slot][0], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(queries[slot][1], GL_QUERY_RESULT, &end);
+            gpuFrameTime = (end - start) / 1e9f;
+            if (enabled && !scaleLocked)
+                adjustScale();
+        }
+        issued[slot] = false;
+    }
+
+    glQueryCounter(queries[slot][0], GL_TIMESTAMP);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, getFramebuffer());
+    glViewport(0, 0, getWidth(), getHeight());
+    if (enabled)
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void DynamicResolution::endFrame()
+{
+    if (enabled)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, getWidth(), getHeight(), 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, windowWidth, windowHeight);
+    }
+
+    int slot = frame % RESOLUTION_GPU_LATENCY;
+    glQueryCounter(queries[slot][1], GL_TIMESTAMP);
+    issued[slot] = true;
+    frame++;
+}
@@ -0,0 +1,190 @@
+#include "testgl/shadercache.hpp"
+#include "testgl/constants.hpp"
+#include "testgl/logging.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <vector>
+
+#define SHADER_CACHE_MAGIC 0x43534754 // "TGSC"
+
+namespace shader_cache
+{
+    namespace
+    {
+        // Header of a cache file, followed by the binary
+        struct FileHeader
+        {
+            uint32_t magic;
+            uint32_t format;
+            uint64_t key;
+        };
+
+        bool supported = false;
+        bool parallel = false;
+        std::string driver;
+        int hits = 0;
+        int misses = 0;
+
+        // FNV-1a, the sources are a few KiB so it does not need to be fast
+        uint64_t hash(uint64_t seed, const std::string &text)
+        {
+            for (unsigned char c : text)
+                seed = (seed ^ c) * 0x100000001B3ull;
+            return (seed ^ 0xFF) * 0x100000001B3ull; // Separator so that "ab" + "c" and "a" + "bc" differ
+        }
+
+        std::string getPath(uint64_t key)
+        {
+            char name[32];
+            snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+            return std::string(SHADER_CACHE_DIR) + "/" + name;
+        }
+
+        std::string getString(GLenum name)
+        {
+            const GLubyte *value = glGetString(name);
+            return value == nullptr ? "" : (const char *)value;
+        }
+    } // namespace
+
+    void init()
+    {
+        driver = getString(GL_VENDOR) + "\n" + getString(GL_RENDERER) + "\n" + getString(GL_VERSION) + "\n" + getString(GL_SHADING_LANGUAGE_VERSION);
+
+        parallel = GLAD_GL_KHR_parallel_shader_compile;
+        if (parallel)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF); // As many as the driver wants
+
+        GLint formats = 0;
+        if (GLAD_GL_ARB_get_program_binary)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        supported = SHADER_CACHE && formats > 0;
+        if (supported)
+        {
+            std::error_code error;
+            std::filesystem::create_directories(SHADER_CACHE_DIR, error);
+            if (error)
+            {
+                log_warn("Could not create %s, the shader cache is disabled: %s", SHADER_CACHE_DIR, error.message().c_str());
+                supported = false;
+            }
+        }
+
+        log_info("Shader cache %s, parallel compilation %s", supported ? "enabled" : "unavailable", parallel ? "enabled" : "unavailable");
+    }
+
+    bool isParallel()
+    {
+        return parallel;
+    }
+
+    uint64_t makeKey(const std::string &vertexCode, const std::string &fragmentCode, const std::string &geometryCode)
+    {
+        uint64_t key = 0xCBF29CE484222325ull;
+        key = hash(key, driver);
+        key = hash(key, vertexCode);
+        key = hash(key, fragmentCode);
+        key = hash(key, geometryCode);
+        return key;
+    }
+
+    bool load(unsigned int program, uint64_t key)
+    {
+        if (!supported)
+        {
+            misses++;
+            return false;
+        }
+
+        FILE *file = fopen(getPath(key).c_str(), "rb");
+        if (file == nullptr)
+        {
+            misses++;
+            return false;
+        }
+
+        FileHeader header;
+        std::vector<char> binary;
+        bool valid = fread(&header, sizeof(header), 1, file) == 1 && header.magic == SHADER_CACHE_MAGIC && header.key == key;
+        if (valid)
+        {
+            fseek(file, 0, SEEK_END);
+            long size = ftell(file) - (long)sizeof(header);
+            fseek(file, sizeof(header), SEEK_SET);
+            binary.resize(size > 0 ? size : 0);
+            valid = size > 0 && fread(binary.data(), 1, binary.size(), file) == binary.size();
+        }
+        fclose(file);
+
+        if (valid)
+        {
+            glProgramBinary(program, header.format, binary.data(), binary.size());
+            GLint success = 0;
+            glGetProgramiv(program, GL_LINK_STATUS, &success);
+            valid = success;
+        }
+
+        if (!valid)
+        {
+            // Stale or truncated, it is written again once the program is compiled
+            log_debug("Ignoring the cached program %016llx", (unsigned long long)key);
+            misses++;
+            return false;
+        }
+        hits++;
+        return true;
+    }
+
+    void prepare(unsigned int program)
+    {
+        if (supported)
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    void store(unsigned int program, uint64_t key)
+    {
+        if (!supported)
+            return;
+
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+
+        FileHeader header = {SHADER_CACHE_MAGIC, 0, key};
+        std::vector<char> binary(length);
+        glGetProgramBinary(program, length, &length, &header.format, binary.data());
+
+        // Written next to the final file and renamed, a crash never leaves a truncated entry behind
+        std::string path = getPath(key);
+        std::string temporaryPath = path + ".tmp";
+        FILE *file = fopen(temporaryPath.c_str(), "wb");
+        if (file == nullptr)
+        {
+            log_warn("Could not open %s to cache a program", temporaryPath.c_str());
+            return;
+        }
+        bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(binary.data(), 1, length, file) == (size_t)length;
+        fclose(file);
+
+        std::error_code error;
+        if (written)
+            std::filesystem::rename(temporaryPath, path, error);
+        if (!written || error)
+        {
+            log_warn("Could not write the cached program %s", path.c_str());
+            std::filesystem::remove(temporaryPath, error);
+        }
+    }
+
+    int getHits()
+    {
+        return hits;
+    }
+
+    int getMisses()
+    {
+        return misses;
+    }
+} // namespace shader_cache
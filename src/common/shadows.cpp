@@ -0,0 +1,284 @@
+#include "testgl/shadows.hpp"
+#include "testgl/chunk.hpp"
+#include "testgl/profiler.hpp"
+
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+bool ShadowCascades::enabled = SHADOWS;
+
+ShadowCascades::ShadowCascades(FrameUniforms *frameUniforms) : shader("../shaders/depth.vert", "../shaders/depth.frag"),
+                                                               pulledShader("../shaders/pulled.vert", "../shaders/depth.frag"),
+                                                               frameUniforms(frameUniforms),
+                                                               cameraPosition(0.0f), sunDirection(0.0f, 1.0f, 0.0f)
+{
+    // The cascade Frame blocks bound themselves when created
+    frameUniforms->bind();
+    FrameUniforms::attach(&shader);
+    FrameUniforms::attach(&pulledShader);
+
+    const float cascadeSplits[SHADOW_CASCADES] = SHADOW_CASCADE_SPLITS;
+    for (int i = 0; i < SHADOW_CASCADES; i++)
+    {
+        splits[i] = cascadeSplits[i];
+        cascades[i] = {};
+        glGenQueries(1, &cascades[i].query);
+    }
+
+    // One layer per cascade, sampled with hardware depth comparison
+    glGenTextures(1, &depthTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, SHADOW_CASCADES, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    const float border[4] = {1.0f, 1.0f, 1.0f, 1.0f}; // Outside of the map is lit
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    glActiveTexture(GL_TEXTURE0 + SHADOW_MAP_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        log_error("Shadow map framebuffer is not complete");
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenBuffers(1, &UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(GPUShadows), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, SHADOWS_BINDING, UBO);
+    upload();
+}
+
+ShadowCascades::~ShadowCascades()
+{
+    for (Cascade &cascade : cascades)
+        glDeleteQueries(1, &cascade.query);
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteTextures(1, &depthTexture);
+    glDeleteBuffers(1, &UBO);
+}
+
+void ShadowCascades::attach(Shader *shader)
+{
+    shader->wait();
+    unsigned int blockIndex = glGetUniformBlockIndex(shader->ID, "Shadows");
+    if (blockIndex == GL_INVALID_INDEX)
+    {
+        log_warn("Shader %u has no Shadows uniform block", shader->ID);
+        return;
+    }
+    glUniformBlockBinding(shader->ID, blockIndex, SHADOWS_BINDING);
+    shader->use();
+    shader->setInt("shadowMap", SHADOW_MAP_UNIT);
+}
+
+void ShadowCascades::beginFrame(glm::vec3 cameraPosition, glm::vec3 sunDirection)
+{
+    this->cameraPosition = cameraPosition;
+    this->sunDirection = glm::normalize(sunDirection);
+
+    // Collect the timings of the previous renders without waiting
+    for (Cascade &cascade : cascades)
+    {
+        if (!cascade.queryIssued)
+            continue;
+        GLint available = 0;
+        glGetQueryObjectiv(cascade.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(cascade.query, GL_QUERY_RESULT, &elapsed);
+        cascade.gpuTime += elapsed / 1e6f;
+        cascade.timedRenders++;
+        cascade.queryIssued = false;
+    }
+}
+
+bool ShadowCascades::intersects(const Cascade &cascade, glm::vec3 boxMin, glm::vec3 boxMax)
+{
+    // Bounds of the box in light space, against the orthographic volume of the cascade
+    glm::vec3 lightMin(INFINITY), lightMax(-INFINITY);
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec3 point(corner & 1 ? boxMax.x : boxMin.x, corner & 2 ? boxMax.y : boxMin.y, corner & 4 ? boxMax.z : boxMin.z);
+        glm::vec3 light = glm::vec3(cascade.view * glm::vec4(point, 1.0f));
+        lightMin = glm::min(lightMin, light);
+        lightMax = glm::max(lightMax, light);
+    }
+    // The camera looks down -z
+    float depth = 2.0f * cascade.radius + SHADOW_CASTER_DISTANCE;
+    return lightMax.x >= -cascade.radius && lightMin.x <= cascade.radius &&
+           lightMax.y >= -cascade.radius && lightMin.y <= cascade.radius &&
+           lightMax.z >= -depth && lightMin.z <= 0.0f;
+}
+
+void ShadowCascades::fit(Cascade &cascade, float radius)
+{
+    cascade.radius = radius;
+    cascade.direction = sunDirection;
+
+    glm::vec3 up = std::abs(sunDirection.x) > 0.9f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+
+    // Snap the center to the texels of the map so that the shadows do not shimmer when the camera moves
+    glm::mat4 rotation = glm::lookAt(glm::vec3(0.0f), -sunDirection, up);
+    float texelSize = 2.0f * radius / SHADOW_MAP_SIZE;
+    glm::vec3 center = glm::vec3(rotation * glm::vec4(cameraPosition, 1.0f));
+    center.x = std::floor(center.x / texelSize) * texelSize;
+    center.y = std::floor(center.y / texelSize) * texelSize;
+    cascade.center = glm::vec3(glm::inverse(rotation) * glm::vec4(center, 1.0f));
+
+    // Start far enough towards the sun to catch the casters outside of the sphere
+    glm::vec3 eye = cascade.center + sunDirection * (radius + SHADOW_CASTER_DISTANCE);
+    cascade.view = glm::lookAt(eye, cascade.center, up);
+    cascade.projection = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius + SHADOW_CASTER_DISTANCE);
+    cascade.valid = true;
+    cascade.dirty = false;
+}
+
+void ShadowCascades::renderCascade(int index, const std::map<ChunkPos, Chunk *> &chunks)
+{
+    Cascade &cascade = cascades[index];
+    cascade.renders++;
+
+    cascadeFrames[index].setCamera(cascade.view, cascade.projection, cascade.center);
+    cascadeFrames[index].upload();
+    cascadeFrames[index].bind();
+
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, index);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    if (!cascade.queryIssued)
+        glBeginQuery(GL_TIME_ELAPSED, cascade.query);
+
+    // A point far towards the sun, so that Chunk::draw keeps the sides facing the sun
+    glm::vec3 sunPoint = cascade.center + cascade.direction * (cascade.radius + SHADOW_CASTER_DISTANCE) * 16.0f;
+    for (auto &[pos, chunk] : chunks)
+    {
+        if (!chunk->isDrawable())
+            continue;
+        glm::vec3 origin = ChunkPosTools::toWorldPos(pos);
+        if (!intersects(cascade, origin + chunk->getDrawBoundsMin(), origin + chunk->getDrawBoundsMax()))
+            continue;
+        chunk->draw(chunk->isPulled() ? &pulledShader : &shader, sunPoint);
+    }
+
+    if (!cascade.queryIssued)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        cascade.queryIssued = true;
+    }
+}
+
+void ShadowCascades::render(const std::map<ChunkPos, Chunk *> &chunks, const std::vector<ChunkPos> &remeshed)
+{
+    profile_scope(Shadows);
+
+    if (!enabled)
+    {
+        for (Cascade &cascade : cascades)
+            cascade.valid = false;
+        upload();
+        return;
+    }
+
+    // Chunks that changed invalidate the cached cascades they can cast a shadow in
+    for (ChunkPos pos : remeshed)
+    {
+        glm::vec3 origin = ChunkPosTools::toWorldPos(pos);
+        for (Cascade &cascade : cascades)
+        {
+            if (cascade.valid && !cascade.dirty && intersects(cascade, origin - 0.5f, origin + (CHUNK_SIZE - 0.5f)))
+                cascade.dirty = true;
+        }
+    }
+
+    const float angleThreshold = std::cos(SHADOW_ANGLE_THRESHOLD * 3.14159265f / 180.0f);
+    int cachedUpdates = 0;
+    bool rendered = false;
+
+    GLint previousFramebuffer, viewport[4], polygonMode[2];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+
+    for (int i = 0; i < SHADOW_CASCADES; i++)
+    {
+        Cascade &cascade = cascades[i];
+
+        // The cached cascades are larger so that the camera can move inside them
+        float radius = i == 0 ? splits[i] : splits[i] * (1.0f + SHADOW_CACHE_MARGIN);
+        bool stale = !cascade.valid || cascade.dirty || i == 0 ||
+                     glm::distance(cameraPosition, cascade.center) + splits[i] > cascade.radius ||
+                     glm::dot(sunDirection, cascade.direction) < angleThreshold;
+        if (!stale)
+            continue;
+        // Spread the cached cascades over several frames, unless they cannot be used at all
+        if (i > 0 && cascade.valid && cachedUpdates == SHADOW_MAX_CACHED_UPDATES)
+            continue;
+        if (i > 0)
+            cachedUpdates++;
+
+        if (!rendered)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+            glViewport(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            glEnable(GL_POLYGON_OFFSET_FILL);
+            glPolygonOffset(SHADOW_SLOPE_BIAS, 1.0f);
+            rendered = true;
+        }
+        fit(cascade, radius);
+        renderCascade(i, chunks);
+    }
+
+    if (rendered)
+    {
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glPolygonMode(GL_FRONT_AND_BACK, polygonMode[0]);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+        frameUniforms->bind();
+    }
+    upload();
+}
+
+void ShadowCascades::upload()
+{
+    GPUShadows data = {};
+    // Maps [-1, 1] clip coordinates to [0, 1] texture coordinates
+    const glm::mat4 bias = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)), glm::vec3(0.5f));
+    for (int i = 0; i < SHADOW_CASCADES; i++)
+    {
+        const Cascade &cascade = cascades[i];
+        if (!cascade.valid)
+            continue;
+        data.matrices[i] = bias * cascade.projection * cascade.view;
+        // The distance at which this cascade stops being used stays the same, the margin is for the camera
+        data.splits[i] = splits[i];
+        data.texelSizes[i] = 2.0f * cascade.radius / SHADOW_MAP_SIZE;
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(GPUShadows), &data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void ShadowCascades::resetStats()
+{
+    for (Cascade &cascade : cascades)
+    {
+        cascade.gpuTime = 0.0f;
+        cascade.renders = 0;
+        cascade.timedRenders = 0;
+    }
+}
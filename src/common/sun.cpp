@@ -14,17 +14,17 @@ Sun::Sun(Shader *shader)
     diffuse = 0.6f;
     specular = 0.8f;
 
-    view = glm::mat4(1.0f);
-    projection = glm::mat4(1.0f);
+    direction = glm::vec3(0.0f, 1.0f, 0.0f);
 
     currentTime = 0.0f;
 
+    setupShader(shader);
+}
+
+void Sun::setupShader(Shader *shader)
+{
+    // The position changes every frame, it lives in the Frame uniform block
     shader->use();
-    //  vec3 position;
-    // vec3 ambient;
-    // vec3 diffuse;
-    // vec3 specular;
-    shader->setVec3("light.position", position);
     shader->setVec3("light.ambient", color * ambient);
     shader->setVec3("light.diffuse", color * diffuse);
     shader->setVec3("light.specular", color * specular);
@@ -38,8 +38,7 @@ void Sun::update(float delta_time, glm::vec3 player_position)
 {
     currentTime += delta_time;
     // Update the position of the sun
-    position = player_position + glm::vec3(cos(currentTime / DAY_LENGTH / 10.0f * TWO_PI) * 25.0f, cos(currentTime / DAY_LENGTH * TWO_PI) * SUN_HEIGHT, sin(currentTime / DAY_LENGTH * TWO_PI) * SUN_HEIGHT);
-    // Update the shader
-    shader->use();
-    shader->setVec3("light.position", position);
+    glm::vec3 offset = glm::vec3(cos(currentTime / DAY_LENGTH / 10.0f * TWO_PI) * 25.0f, cos(currentTime / DAY_LENGTH * TWO_PI) * SUN_HEIGHT, sin(currentTime / DAY_LENGTH * TWO_PI) * SUN_HEIGHT);
+    position = player_position + offset;
+    direction = glm::normalize(offset);
 }
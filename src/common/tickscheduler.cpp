@@ -0,0 +1,61 @@
+#include "testgl/tickscheduler.hpp"
+#include "testgl/logging.hpp"
+
+#include <thread>
+
+#define STAGE_COST_SMOOTHING 0.2f // weight of the last measure in the estimate
+
+TickScheduler::TickScheduler(int ticksPerSecond) : period(std::chrono::duration_cast<clock::duration>(std::chrono::seconds(1)) / ticksPerSecond),
+                                                   accumulator(clock::duration::zero()),
+                                                   previous(clock::now())
+{
+}
+
+TickScheduler::clock::time_point TickScheduler::beginTick()
+{
+    clock::time_point now = clock::now();
+    accumulator += now - previous;
+    previous = now;
+
+    // Sleep until the tick is due
+    if (accumulator < period)
+    {
+        std::this_thread::sleep_until(now + (period - accumulator));
+        now = clock::now();
+        accumulator += now - previous;
+        previous = now;
+    }
+
+    // Give up on the ticks we cannot catch up with
+    if (accumulator > period * MAX_TICK_CATCH_UP)
+    {
+        log_warn("Tick thread is %d ticks late, skipping them", (int)(accumulator / period) - MAX_TICK_CATCH_UP);
+        accumulator = period * MAX_TICK_CATCH_UP;
+    }
+    accumulator -= period;
+
+    // The work has to end before the next tick is due, which is sooner when we are late
+    clock::duration slack = period - accumulator;
+    if (slack < clock::duration::zero())
+        slack = clock::duration::zero();
+    return now + std::chrono::duration_cast<clock::duration>(slack * TICK_BUDGET);
+}
+
+int StageCost::chunksFor(TickScheduler::clock::duration budget)
+{
+    float seconds = std::chrono::duration<float>(budget).count();
+    int chunks = (int)(seconds / perChunk);
+    if (chunks < 1)
+        return 1;
+    if (chunks > MAX_CHUNKS_PER_STAGE)
+        return MAX_CHUNKS_PER_STAGE;
+    return chunks;
+}
+
+void StageCost::update(TickScheduler::clock::duration elapsed, int chunks)
+{
+    if (chunks <= 0)
+        return; // Nothing was done, the measure says nothing about the cost
+    float measured = std::chrono::duration<float>(elapsed).count() / chunks;
+    perChunk += (measured - perChunk) * STAGE_COST_SMOOTHING;
+}
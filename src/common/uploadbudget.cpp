@@ -0,0 +1,47 @@
+#include "testgl/uploadbudget.hpp"
+
+#include <algorithm>
+
+#define UPLOAD_THROUGHPUT_SMOOTHING 0.1f // weight of the last measure in the throughput estimate
+#define UPLOAD_MIN_MEASURE 4096          // in bytes, smaller uploads are dominated by the call overhead
+
+UploadBudget::UploadBudget() : throughput(UPLOAD_INITIAL_THROUGHPUT)
+{
+    resetStats();
+}
+
+size_t UploadBudget::nextFrame(float previousFrameTime)
+{
+    // Count the frame time spikes that follow an upload
+    if (lastFrameBytes > 0 && previousFrameTime > UPLOAD_TARGET_FRAME_TIME * UPLOAD_SPIKE_FACTOR)
+        spikes++;
+
+    // Keep the frame under the target: the time we are already over it is taken from the upload share
+    float time = UPLOAD_TARGET_FRAME_TIME * UPLOAD_FRAME_FRACTION;
+    if (previousFrameTime > UPLOAD_TARGET_FRAME_TIME)
+        time -= previousFrameTime - UPLOAD_TARGET_FRAME_TIME;
+
+    size_t bytes = time > 0.0f ? (size_t)(time * throughput) : 0;
+    return std::clamp(bytes, (size_t)UPLOAD_MIN_BYTES_PER_FRAME, (size_t)UPLOAD_MAX_BYTES_PER_FRAME);
+}
+
+void UploadBudget::update(size_t bytes, float seconds)
+{
+    lastFrameBytes = bytes;
+    totalBytes += bytes;
+    maxFrameBytes = std::max(maxFrameBytes, bytes);
+    frames++;
+
+    if (bytes < UPLOAD_MIN_MEASURE || seconds <= 0.0f)
+        return;
+    throughput += (bytes / seconds - throughput) * UPLOAD_THROUGHPUT_SMOOTHING;
+}
+
+void UploadBudget::resetStats()
+{
+    totalBytes = 0;
+    maxFrameBytes = 0;
+    frames = 0;
+    spikes = 0;
+    lastFrameBytes = 0;
+}
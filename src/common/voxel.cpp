@@ -0,0 +1,61 @@
+#include "testgl/voxel.hpp"
+#include "testgl/constants.hpp"
+
+namespace ShaderData
+{
+    namespace
+    {
+        unsigned int materialsUBO = 0;
+
+        GPUMaterial pack(const Material &material)
+        {
+            GPUMaterial packed = {};
+            packed.ambient = vec4(material.ambient, 0.0f);
+            packed.diffuse = vec4(material.diffuse, 0.0f);
+            packed.specular = material.specular;
+            packed.shininess = material.shininess;
+            packed.flow = material.flow;
+            return packed;
+        }
+
+        void createBuffer()
+        {
+            // Unused entries stay zeroed
+            GPUMaterial table[MATERIAL_COUNT] = {};
+            for (size_t i = 0; i < sizeof(materials) / sizeof(Material); i++)
+                table[i] = pack(materials[i]);
+
+            glGenBuffers(1, &materialsUBO);
+            glBindBuffer(GL_UNIFORM_BUFFER, materialsUBO);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(table), table, GL_STATIC_DRAW);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            glBindBufferBase(GL_UNIFORM_BUFFER, MATERIALS_BINDING, materialsUBO);
+        }
+    } // namespace
+
+    void setupMaterials(Shader *shader)
+    {
+        if (materialsUBO == 0)
+            createBuffer();
+
+        shader->wait();
+        unsigned int blockIndex = glGetUniformBlockIndex(shader->ID, "Materials");
+        if (blockIndex == GL_INVALID_INDEX)
+        {
+            log_warn("Shader %u has no Materials uniform block", shader->ID);
+            return;
+        }
+        glUniformBlockBinding(shader->ID, blockIndex, MATERIALS_BINDING);
+    }
+
+    void updateMaterial(int index, const Material &material)
+    {
+        if (materialsUBO == 0 || index < 0 || index >= MATERIAL_COUNT)
+            return;
+
+        GPUMaterial packed = pack(material);
+        glBindBuffer(GL_UNIFORM_BUFFER, materialsUBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, index * sizeof(GPUMaterial), sizeof(GPUMaterial), &packed);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+} // namespace ShaderData
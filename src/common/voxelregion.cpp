@@ -0,0 +1,51 @@
+#include "testgl/voxelregion.hpp"
+
+#include <utility>
+
+VoxelRegion::VoxelRegion(glm::ivec3 size, Voxel fillVoxel) : size(glm::max(size, glm::ivec3(0))), fillVoxel(fillVoxel)
+{
+}
+
+VoxelRegion VoxelRegion::box(glm::ivec3 size)
+{
+    return VoxelRegion(size);
+}
+
+VoxelRegion VoxelRegion::sphere(int radius)
+{
+    VoxelRegion region(glm::ivec3(2 * radius + 1));
+    region.mask.resize(region.size.x * region.size.y * region.size.z);
+    // The voxels whose center is inside the sphere
+    for (int z = -radius; z <= radius; z++)
+        for (int y = -radius; y <= radius; y++)
+            for (int x = -radius; x <= radius; x++)
+                region.mask[region.index(x + radius, y + radius, z + radius)] = x * x + y * y + z * z <= radius * radius;
+    return region;
+}
+
+VoxelRegion VoxelRegion::masked(glm::ivec3 size, std::vector<uint8_t> mask)
+{
+    VoxelRegion region(size);
+    region.mask = std::move(mask);
+    region.mask.resize(region.size.x * region.size.y * region.size.z);
+    return region;
+}
+
+void VoxelRegion::maskAir()
+{
+    if (mask.empty())
+        mask.assign(size.x * size.y * size.z, 1);
+    for (size_t i = 0; i < mask.size(); i++)
+        mask[i] = mask[i] && (voxels.empty() ? fillVoxel : voxels[i]) != Voxel::Air;
+}
+
+void VoxelRegion::set(int x, int y, int z, Voxel voxel)
+{
+    if (voxels.empty())
+    {
+        if (voxel == fillVoxel)
+            return;
+        voxels.assign(size.x * size.y * size.z, fillVoxel);
+    }
+    voxels[index(x, y, z)] = voxel;
+}
@@ -2,6 +2,11 @@
 #include "testgl/logging.hpp"
 #include "testgl/constants.hpp"
 #include "testgl/callbacks.hpp"
+#include "testgl/shadercache.hpp"
+
+int Window::framebufferWidth = WINDOW_WIDTH;
+int Window::framebufferHeight = WINDOW_HEIGHT;
+bool Window::headless = false;
 
 Window::Window(const char *title, int height, int width, bool shouldInitGLAD)
     : failed(false)
@@ -9,31 +14,43 @@ Window::Window(const char *title, int height, int width, bool shouldInitGLAD)
     // Create a window
     log_debug("Creating window");
     window = glfwCreateWindow(width, height, title, NULL, NULL);
+    if (!window && headless)
+    {
+        // No EGL surfaceless support, fall back to the Mesa software context
+        log_warn("Could not create an EGL context, trying OSMesa");
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+        window = glfwCreateWindow(width, height, title, NULL, NULL);
+    }
     if (!window)
     {
         log_fatal("Failed to create window");
         glfwTerminate();
         failed = true;
     }
+    else
+    {
+        // Hidden windows get no size callback, and the framebuffer is bigger than the window on high DPI screens
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    }
 
     // Make the window's context current
     log_debug("Making window context current");
     glfwMakeContextCurrent(window);
 
-    // Setup the GLFW window size callback
-    log_debug("Setting up GLFW window size callback");
-    glfwSetWindowSizeCallback(window, glfw_window_size_callback);
-    glfwSwapInterval(GLFW_VSYNC); // Enable vsync
+    // Setup the GLFW framebuffer size callback, it also fires when only the content scale changes
+    log_debug("Setting up GLFW framebuffer size callback");
+    glfwSetFramebufferSizeCallback(window, glfw_framebuffer_size_callback);
+    // The swap interval is set by FramePacer
 
     // Capture the mouse if needed
-    if (CAPTURE_MOUSE)
+    if (CAPTURE_MOUSE && !headless)
         glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
     if (shouldInitGLAD)
     {
         initGLAD();
     }
-    glfw_window_size_callback(window, width, height);
+    glViewport(0, 0, framebufferWidth, framebufferHeight);
     initGL();
 }
 
@@ -69,11 +86,17 @@ void Window::initGL()
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
-int Window::initGLFW()
+int Window::initGLFW(bool headless)
 { // Setup the GLFW error callback
     log_debug("Setting up GLFW error callback");
     glfwSetErrorCallback(glfw_error_callback);
 
+    Window::headless = headless;
+#ifdef GLFW_PLATFORM_NULL
+    if (headless)
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL); // No display server needed (GLFW 3.4)
+#endif
+
     // Initialize GLFW
     log_debug("Initializing GLFW");
     if (!glfwInit())
@@ -91,6 +114,12 @@ int Window::initGLFW()
 #ifdef GLFW_REQUEST_DEBUG_CONTEXT
     glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, true); // Debug context
 #endif
+    if (headless)
+    {
+        // Surfaceless EGL works with Mesa llvmpipe, OSMesa is tried if it fails (see the constructor)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+    }
     return EXIT_SUCCESS;
 }
 
@@ -107,6 +136,8 @@ int Window::initGLAD()
     // Print OpenGL information
     log_info("OpenGL %s, GLSL %s", glGetString(GL_VERSION), glGetString(GL_SHADING_LANGUAGE_VERSION));
 
+    shader_cache::init();
+
     return EXIT_SUCCESS;
 }
 
@@ -1,9 +1,19 @@
 #include "testgl/world.hpp"
+#include "testgl/profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <thread>
 
 #define VIEW_DISTANCE_2 VIEW_DISTANCE *VIEW_DISTANCE
 
 using namespace ChunkPosTools;
 
+bool World::visibilityCulling = VISIBILITY_CULLING;
+std::atomic<bool> World::remeshRequested(false);
+
 void World::nextChunkToLoad()
 {
     // Load a square of chunks around the player
@@ -37,7 +47,8 @@ bool World::isChunkLoaded(ChunkPos pos)
     return chunks.find(pos) != chunks.end();
 }
 
-World::World(glm::vec3 *playerPos, WorldGenerator::function_t worldGenerator) : playerPos(playerPos), chunks(), worldGenerator(worldGenerator), nTicks(0)
+World::World(glm::vec3 *playerPos, WorldGenerator::function_t worldGenerator) : playerPos(playerPos), chunks(), lightEngine(chunks), worldGenerator(worldGenerator),
+                                                                                occlusionCuller(nullptr), depthPrepass(nullptr), pulledShader(nullptr), shadowCascades(nullptr), visibleMeshBytes(0), visibleFaces(0), nTicks(0), voxelBytes(0), denseVoxelBytes(0), lightBytes(0), chunkBytes(0)
 {
     playerChunk = fromWorldPos(*playerPos);
     chunksToLoad.push(makeChunkPosWithDist(playerChunk));
@@ -61,9 +72,11 @@ void World::createChunk(ChunkPos pos)
     Chunk *chunk = new Chunk(getX(pos), getY(pos), getZ(pos), this);
     chunksMutex.lock();
     chunks[pos] = chunk;
+    chunk->setHandle(chunkHandles.insert(chunk));
     chunksMutex.unlock();
     ChunkPos relativePos = pos - playerChunk;
     chunk->populate(worldGenerator);
+    chunksToLight.push_back(chunk->getHandle());
 
     // Update the chunk's side occlusion with the neighboring chunks
     for (int side = 0; side < 6; side++)
@@ -115,7 +128,7 @@ World::ChunkPosWithDist World::makeChunkPosWithDist(ChunkPos pos)
 
 World::ChunkWithDist World::makeChunkWithDist(Chunk *chunk)
 {
-    return ChunkWithDist(chunk, distanceFunction(chunk));
+    return ChunkWithDist(chunk->getHandle(), distanceFunction(chunk));
 }
 void World::addToLoadQueue(ChunkPos pos)
 {
@@ -140,17 +153,20 @@ void World::addToUploadQueue(Chunk *chunk)
     chunksToUploadMutex.unlock();
 }
 
-void World::loadChunks(int numberOfChunks)
+int World::loadChunks(int numberOfChunks)
 {
+    profile_scope(TickLoad);
+
+    int loaded = 0;
     // Always load the chunk the player is in
     if (!isChunkLoaded(playerChunk))
     {
         createChunk(playerChunk);
-        numberOfChunks--;
+        loaded++;
     }
     nextChunkToLoad();
     // Iterate through `chunks` and load each chunk
-    while (!chunksToLoad.empty())
+    while (!chunksToLoad.empty() && loaded < numberOfChunks)
     {
         ChunkPos pos = chunksToLoad.top().first;
         chunksToLoad.pop();
@@ -158,15 +174,53 @@ void World::loadChunks(int numberOfChunks)
         if (!isChunkLoaded(pos))
         {
             createChunk(pos);
-            numberOfChunks--;
-            if (numberOfChunks == 0)
-                break;
+            loaded++;
         }
     }
+    lightNewChunks();
+    return loaded;
 }
 
-void World::updateSideOcclusion(int numberOfChunks)
+void World::lightNewChunks()
 {
+    std::vector<Chunk *> batch;
+    for (ChunkHandle handle : chunksToLight)
+    {
+        Chunk *chunk = chunkHandles.get(handle);
+        if (chunk != nullptr)
+            batch.push_back(chunk);
+    }
+    chunksToLight.clear();
+    if (batch.empty())
+        return;
+
+    // Each chunk only floods its own light, so they can be calculated at the same time
+    lightWorkers.light(batch);
+
+    // Crossing the borders touches the neighbors, one chunk at a time
+    for (Chunk *chunk : batch)
+        lightEngine.connect(chunk);
+    remeshLitChunks();
+}
+
+void World::remeshLitChunks()
+{
+    std::vector<ChunkPos> changed;
+    lightEngine.takeChangedChunks(changed);
+    for (ChunkPos pos : changed)
+    {
+        Chunk *chunk = getChunk(pos);
+        if (chunk == nullptr || chunk->getNeedsSideOcclusionUpdate())
+            continue; // Will be meshed once its side occlusion is known
+        chunk->setNeedsMeshUpdate(true);
+        addToMeshQueue(chunk);
+    }
+}
+
+int World::updateSideOcclusion(int numberOfChunks)
+{
+    profile_scope(TickOcclusion);
+
     int counter = numberOfChunks;
     // First we update the side occlusion of the needed chunks so that we can
     // update the side occlusion of the neighboring chunks later
@@ -206,7 +260,8 @@ void World::updateSideOcclusion(int numberOfChunks)
     // Iterate through `chunks` and update the side occlusion of each chunk
     while (!chunksToFaceOcclude.empty())
     {
-        Chunk *chunk = chunksToFaceOcclude.top().first;
+        // Stale handles belong to chunks deleted since they were queued
+        Chunk *chunk = chunkHandles.get(chunksToFaceOcclude.top().first);
         chunksToFaceOcclude.pop();
         if (chunk == nullptr)
             continue;
@@ -218,50 +273,68 @@ void World::updateSideOcclusion(int numberOfChunks)
                 break;
         }
     }
+    return numberOfChunks - counter;
 }
 
-void World::updateMesh(int numberOfChunks)
+int World::updateMesh(int numberOfChunks)
 {
+    profile_scope(TickMesh);
+
+    int meshed = 0;
     // Iterate through `chunks` and update the mesh of each chunk
     while (!chunksToMesh.empty())
     {
-        Chunk *chunk = chunksToMesh.top().first;
+        // Stale handles belong to chunks deleted since they were queued
+        Chunk *chunk = chunkHandles.get(chunksToMesh.top().first);
         chunksToMesh.pop();
         if (chunk == nullptr)
             continue;
         if (chunk->getNeedsMeshUpdate())
         {
             chunk->generateMesh();
-            numberOfChunks--;
-            if (numberOfChunks == 0)
+            meshed++;
+            if (meshed == numberOfChunks)
                 break;
         }
     }
+    return meshed;
 }
 
-void World::uploadMesh(int numberOfChunks)
+size_t World::uploadMesh(size_t byteBudget)
 {
+    profile_scope(Upload);
+    profile_gpu_begin(Upload);
+
+    size_t uploaded = 0;
     // Iterate through `chunks` and upload the mesh of each chunk
     chunksToUploadMutex.lock();
-    while (!chunksToUpload.empty())
+    while (!chunksToUpload.empty() && uploaded < byteBudget)
     {
-        Chunk *chunk = chunksToUpload.top().first;
+        // Stale handles belong to chunks deleted since they were queued
+        Chunk *chunk = chunkHandles.get(chunksToUpload.top().first);
         chunksToUpload.pop();
         if (chunk == nullptr)
             continue;
         if (chunk->getNeedsMeshUpload())
         {
-            chunk->uploadMesh();
-            numberOfChunks--;
-            if (numberOfChunks == 0)
-                break;
+            uploaded += chunk->uploadMesh(byteBudget - uploaded);
+            // Large meshes are split across frames, the rest will be uploaded next time
+            if (chunk->getNeedsMeshUpload())
+                chunksToUpload.push(makeChunkWithDist(chunk));
+            else
+                uploadedChunks.push_back(chunk->getPos());
         }
     }
     chunksToUploadMutex.unlock();
+
+    profile_gpu_end();
+    return uploaded;
 }
 
 void World::discardChunks()
 {
+    profile_scope(Discard);
+
     // Iterate through `chunks` and delete the chunks that are too far away from the player
     for (auto &[pos, chunk] : chunks)
     {
@@ -269,23 +342,10 @@ void World::discardChunks()
             chunk->discard();
     }
 }
-// https://stackoverflow.com/a/29325258/15860367
-// Provides access to the container of the priority_queue
-template <class ADAPTER>
-typename ADAPTER::container_type &get_container(ADAPTER &a)
-{
-    struct hack : ADAPTER
-    {
-        static typename ADAPTER::container_type &get(ADAPTER &a)
-        {
-            return a.*&hack::c;
-        }
-    };
-    return hack::get(a);
-}
-
 void World::deleteChunks()
 {
+    profile_scope(TickDelete);
+
     // Iterate through `chunks` and delete the chunks that are too far away from the player
     bool needsDeletion = false;
     for (auto &[pos, chunk] : chunks)
@@ -295,42 +355,14 @@ void World::deleteChunks()
     if (!needsDeletion)
         return;
 
-    // Iterate through all the queued chunks and replace them with nullptr
-    // This is done to prevent the tick thread to update a chunk that is no longer in the world
-    std::vector<ChunkWithDist> &chunksToFaceOccludeContainer = get_container(chunksToFaceOcclude);
-    for (auto &chunk : chunksToFaceOccludeContainer)
-    {
-        if (chunk.first == nullptr)
-            continue;
-        if (chunk.first->getScheduleForDeletion())
-            chunk.first = nullptr;
-    }
-    std::vector<ChunkWithDist> &chunksToMeshContainer = get_container(chunksToMesh);
-    for (auto &chunk : chunksToMeshContainer)
-    {
-        if (chunk.first == nullptr)
-            continue;
-        if (chunk.first->getScheduleForDeletion())
-            chunk.first = nullptr;
-    }
-
-    chunksToUploadMutex.lock();
-    std::vector<ChunkWithDist> &chunksToUploadContainer = get_container(chunksToUpload);
-    for (auto &chunk : chunksToUploadContainer)
-    {
-        if (chunk.first == nullptr)
-            continue;
-        if (chunk.first->getScheduleForDeletion())
-            chunk.first = nullptr;
-    }
-    chunksToUploadMutex.unlock();
-
     // Delete the chunks that are scheduled for deletion
     chunksMutex.lock();
     for (auto it = chunks.begin(); it != chunks.end();)
     {
         if (it->second->getScheduleForDeletion())
         {
+            // Queued handles to this chunk become stale and are skipped when popped
+            chunkHandles.release(it->second->getHandle());
             delete it->second;
             it = chunks.erase(it);
         }
@@ -341,13 +373,117 @@ void World::deleteChunks()
     chunksMutex.unlock();
 }
 
+void World::findVisibleChunks()
+{
+    visibleChunks.clear();
+
+    ChunkPos cameraChunk = fromWorldPos(*playerPos);
+    Chunk *start = getChunk(cameraChunk);
+    if (!visibilityCulling || start == nullptr)
+    {
+        // Nothing to start the search from, draw everything
+        for (auto &[pos, chunk] : chunks)
+            visibleChunks.push_back(chunk);
+        return;
+    }
+
+    // Breadth first search through the faces that can see each other
+    struct Step
+    {
+        Chunk *chunk;
+        int enteredFrom; // Side index, -1 for the camera chunk
+        Sides directions; // Directions travelled so far, we never go back towards the camera
+    };
+    std::queue<Step> queue;
+    std::unordered_set<ChunkPos, ChunkPosHash> visited;
+    queue.push({start, -1, Side::NONE});
+    visited.insert(cameraChunk);
+
+    while (!queue.empty())
+    {
+        Step step = queue.front();
+        queue.pop();
+        visibleChunks.push_back(step.chunk);
+
+        for (int side = 0; side < 6; side++)
+        {
+            Side sideEnum = static_cast<Side>(1 << side);
+            if (step.directions & opposite_side(sideEnum))
+                continue;
+            if (step.enteredFrom != -1 && !step.chunk->canSeeThrough(step.enteredFrom, side))
+                continue;
+
+            ChunkPos neighborPos = step.chunk->getPos() + dirFromSide(sideEnum);
+            if (visited.count(neighborPos))
+                continue;
+            Chunk *neighbor = getChunk(neighborPos);
+            if (neighbor == nullptr)
+                continue;
+            visited.insert(neighborPos);
+            queue.push({neighbor, side_to_index(opposite_side(sideEnum)), (Sides)(step.directions | sideEnum)});
+        }
+    }
+}
+
+void World::sortVisibleChunks()
+{
+    // Distance from the camera to the center of each chunk, computed once per chunk
+    std::vector<std::pair<float, Chunk *>> sorted;
+    sorted.reserve(visibleChunks.size());
+    for (Chunk *chunk : visibleChunks)
+    {
+        glm::vec3 center = glm::vec3(toWorldPos(chunk->getPos())) + glm::vec3(CHUNK_SIZE / 2.0f);
+        sorted.emplace_back(glm::distance2(center, *playerPos), chunk);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b)
+              { return a.first < b.first; });
+
+    visibleMeshBytes = 0;
+    visibleFaces = 0;
+    for (size_t i = 0; i < sorted.size(); i++)
+    {
+        visibleChunks[i] = sorted[i].second;
+        visibleMeshBytes += visibleChunks[i]->getDrawBytes();
+        visibleFaces += visibleChunks[i]->getDrawSize() / 6;
+    }
+}
+
 void World::draw(Shader *shader)
 {
-    // Iterate through `chunks` and draw each chunk
-    for (auto &[pos, chunk] : chunks)
     {
-        chunk->draw(shader);
+        profile_scope(Draw);
+        findVisibleChunks();
+        sortVisibleChunks();
+    }
+
+    if (depthPrepass != nullptr && DepthPrepass::enabled)
+    {
+        profile_scope(Prepass);
+        profile_gpu_begin(Prepass);
+        depthPrepass->draw(visibleChunks, *playerPos);
+        profile_gpu_end();
+    }
+
+    profile_scope(Draw);
+    profile_gpu_begin(Draw);
+    // Only one occlusion query can be active, the fragments are not counted while the culler issues its own
+    bool culling = occlusionCuller != nullptr && OcclusionCuller::enabled;
+    if (depthPrepass != nullptr)
+        depthPrepass->beginShading(!culling);
+
+    // Draw each chunk the camera can see, nearest first
+    for (Chunk *chunk : visibleChunks)
+    {
+        Shader *chunkShader = chunk->isPulled() ? pulledShader : shader;
+        if (occlusionCuller != nullptr)
+            occlusionCuller->draw(chunk, chunkShader, *playerPos);
+        else
+            chunk->draw(chunkShader, *playerPos);
     }
+
+    if (depthPrepass != nullptr)
+        depthPrepass->endShading();
+    profile_gpu_end();
 }
 
 bool World::setVoxel(int x, int y, int z, Voxel value)
@@ -356,34 +492,264 @@ bool World::setVoxel(int x, int y, int z, Voxel value)
     Chunk *chunk = getChunk(chunkPos);
     if (chunk == nullptr)
         return false;
-    chunk->setVoxel(x % CHUNK_SIZE, y % CHUNK_SIZE, z % CHUNK_SIZE, value);
+    int localX = x - getX(chunkPos) * CHUNK_SIZE, localY = y - getY(chunkPos) * CHUNK_SIZE, localZ = z - getZ(chunkPos) * CHUNK_SIZE;
+    Voxel before = chunk->getVoxel(localX, localY, localZ);
+    if (before == value)
+        return true;
+    chunk->setVoxel(localX, localY, localZ, value);
+    lightEngine.voxelChanged(x, y, z, before);
+    remeshLitChunks();
     return true;
 }
 
+static_assert((CHUNK_SIZE & (CHUNK_SIZE - 1)) == 0, "The raycast aligns the empty chunks with a mask");
+
+// Side of a face from its outward normal
+static Side normalSide(glm::ivec3 normal)
+{
+    if (normal.x != 0)
+        return normal.x < 0 ? Side::LEFT : Side::RIGHT;
+    if (normal.y != 0)
+        return normal.y < 0 ? Side::BOTTOM : Side::TOP;
+    if (normal.z != 0)
+        return normal.z < 0 ? Side::BACK : Side::FRONT;
+    return Side::NONE;
+}
+
+bool World::raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance, RaycastHit *hit)
+{
+    glm::vec3 dir = glm::normalize(direction);
+    // The voxels are centered on their coordinates, shifted so that voxel v spans [v, v + 1)
+    glm::vec3 start = origin + 0.5f;
+    glm::ivec3 step(dir.x > 0.0f ? 1 : -1, dir.y > 0.0f ? 1 : -1, dir.z > 0.0f ? 1 : -1);
+    glm::ivec3 voxel(glm::floor(start));
+    float distance = 0.0f;
+    int enteredAxis = -1; // Axis of the last face crossed
+
+    // Consecutive voxels are mostly in the same chunk
+    ChunkPos chunkPos = fromWorldPos(voxel.x, voxel.y, voxel.z);
+    Chunk *chunk = getChunk(chunkPos);
+    while (true)
+    {
+        ChunkPos pos = fromWorldPos(voxel.x, voxel.y, voxel.z);
+        if (pos != chunkPos)
+        {
+            chunkPos = pos;
+            chunk = getChunk(pos);
+        }
+        glm::ivec3 local = voxel - glm::ivec3(getX(pos), getY(pos), getZ(pos)) * CHUNK_SIZE;
+        // Nothing to hit in the chunks that are not loaded
+        int cell = chunk == nullptr ? CHUNK_SIZE : chunk->getAirCell(local.x, local.y, local.z);
+        if (cell == 0)
+        {
+            hit->voxel = voxel;
+            hit->normal = glm::ivec3(0);
+            if (enteredAxis >= 0)
+                hit->normal[enteredAxis] = -step[enteredAxis];
+            hit->face = normalSide(hit->normal);
+            hit->distance = distance;
+            hit->value = chunk->getVoxel(local.x, local.y, local.z);
+            return true;
+        }
+
+        // Leave the cell through the nearest face ahead of the ray, a cell of one voxel is a step of the classic DDA
+        glm::ivec3 low(voxel.x & ~(cell - 1), voxel.y & ~(cell - 1), voxel.z & ~(cell - 1));
+        float exit = INFINITY;
+        int exitAxis = 0;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (dir[axis] == 0.0f)
+                continue;
+            float boundary = (float)(step[axis] > 0 ? low[axis] + cell : low[axis]);
+            float axisExit = (boundary - start[axis]) / dir[axis];
+            if (axisExit < exit)
+            {
+                exit = axisExit;
+                exitAxis = axis;
+            }
+        }
+        if (exit > maxDistance)
+            return false;
+
+        // The next voxel is across that face, the other coordinates stay inside the cell despite the rounding
+        glm::vec3 point = start + dir * exit;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (axis == exitAxis)
+                voxel[axis] = step[axis] > 0 ? low[axis] + cell : low[axis] - 1;
+            else
+                voxel[axis] = glm::clamp((int)std::floor(point[axis]), low[axis], low[axis] + cell - 1);
+        }
+        distance = std::max(distance, exit);
+        enteredAxis = exitAxis;
+    }
+}
+
+bool World::pickVoxel(glm::vec3 origin, glm::vec3 direction, Voxel value)
+{
+    RaycastHit hit;
+    if (!raycast(origin, direction, PICK_REACH, &hit))
+        return false;
+    if (value == Voxel::Air)
+        return setVoxel(hit.voxel.x, hit.voxel.y, hit.voxel.z, Voxel::Air);
+
+    // The ray came through that voxel so it is air, but not where the camera is
+    glm::ivec3 target = hit.voxel + hit.normal;
+    if (hit.face == Side::NONE || target == glm::ivec3(glm::floor(origin + 0.5f)))
+        return false;
+    return setVoxel(target.x, target.y, target.z, value);
+}
+
+void World::writeRegion(glm::ivec3 origin, const VoxelRegion &region, const Voxel *fill)
+{
+    glm::ivec3 last = origin + region.getSize() - 1;
+    if (last.x < origin.x || last.y < origin.y || last.z < origin.z)
+        return;
+    ChunkPos firstChunk = fromWorldPos(origin.x, origin.y, origin.z);
+    ChunkPos lastChunk = fromWorldPos(last.x, last.y, last.z);
+
+    std::vector<VoxelChange> changes;
+    for (int x = getX(firstChunk); x <= getX(lastChunk); x++)
+    {
+        for (int y = getY(firstChunk); y <= getY(lastChunk); y++)
+        {
+            for (int z = getZ(firstChunk); z <= getZ(lastChunk); z++)
+            {
+                Chunk *chunk = getChunk(ChunkPos(x, y, z));
+                if (chunk != nullptr)
+                    chunk->writeRegion(region, origin - glm::ivec3(x, y, z) * CHUNK_SIZE, fill, changes);
+            }
+        }
+    }
+
+    if (changes.empty())
+        return;
+    lightEngine.voxelsChanged(changes);
+    remeshLitChunks();
+}
+
+void World::fill(glm::ivec3 origin, const VoxelRegion &shape, Voxel value)
+{
+    writeRegion(origin, shape, &value);
+}
+
+void World::fillBox(glm::ivec3 min, glm::ivec3 max, Voxel value)
+{
+    fill(min, VoxelRegion::box(max - min + 1), value);
+}
+
+void World::fillSphere(glm::ivec3 center, int radius, Voxel value)
+{
+    fill(center - radius, VoxelRegion::sphere(radius), value);
+}
+
+VoxelRegion World::copy(glm::ivec3 min, glm::ivec3 max)
+{
+    VoxelRegion region(max - min + 1);
+    ChunkPos firstChunk = fromWorldPos(min.x, min.y, min.z);
+    ChunkPos lastChunk = fromWorldPos(max.x, max.y, max.z);
+    for (int cx = getX(firstChunk); cx <= getX(lastChunk); cx++)
+    {
+        for (int cy = getY(firstChunk); cy <= getY(lastChunk); cy++)
+        {
+            for (int cz = getZ(firstChunk); cz <= getZ(lastChunk); cz++)
+            {
+                Chunk *chunk = getChunk(ChunkPos(cx, cy, cz));
+                if (chunk == nullptr || chunk->isEmpty())
+                    continue;
+                // Part of the chunk inside the box, in world coordinates
+                glm::ivec3 chunkOrigin = glm::ivec3(cx, cy, cz) * CHUNK_SIZE;
+                glm::ivec3 first = glm::max(min, chunkOrigin);
+                glm::ivec3 last = glm::min(max, chunkOrigin + CHUNK_SIZE - 1);
+                for (int z = first.z; z <= last.z; z++)
+                    for (int y = first.y; y <= last.y; y++)
+                        for (int x = first.x; x <= last.x; x++)
+                            region.set(x - min.x, y - min.y, z - min.z, chunk->getVoxel(x - chunkOrigin.x, y - chunkOrigin.y, z - chunkOrigin.z));
+            }
+        }
+    }
+    return region;
+}
+
+void World::paste(glm::ivec3 origin, const VoxelRegion &region)
+{
+    writeRegion(origin, region, nullptr);
+}
+
 Voxel World::getVoxel(int x, int y, int z)
 {
     ChunkPos chunkPos = fromWorldPos(x, y, z);
     Chunk *chunk = getChunk(chunkPos);
     if (chunk == nullptr)
         return Voxel::Air;
-    return chunk->getVoxel(x % CHUNK_SIZE, y % CHUNK_SIZE, z % CHUNK_SIZE);
+    // Not `x % CHUNK_SIZE`, which is negative for negative coordinates
+    return chunk->getVoxel(x - getX(chunkPos) * CHUNK_SIZE, y - getY(chunkPos) * CHUNK_SIZE, z - getZ(chunkPos) * CHUNK_SIZE);
+}
+
+int World::getLight(int x, int y, int z, LightChannel channel)
+{
+    ChunkPos chunkPos = fromWorldPos(x, y, z);
+    Chunk *chunk = getChunk(chunkPos);
+    if (chunk == nullptr)
+        return -1;
+    return chunk->getLight(x - getX(chunkPos) * CHUNK_SIZE, y - getY(chunkPos) * CHUNK_SIZE, z - getZ(chunkPos) * CHUNK_SIZE, channel);
 }
 
 void World::loadAllChunks()
 {
-    loadChunks(VIEW_DISTANCE * VIEW_DISTANCE * VIEW_DISTANCE * 8);
+    auto start = std::chrono::steady_clock::now();
+    buildStats.generatedChunks += loadChunks(VIEW_DISTANCE * VIEW_DISTANCE * VIEW_DISTANCE * 8);
+    auto generated = std::chrono::steady_clock::now();
 
     // Update the side occlusion of the chunks around the player
     updateSideOcclusion(VIEW_DISTANCE * VIEW_DISTANCE * VIEW_DISTANCE * 8);
 
     // Update the mesh of the chunks around the player
-    updateMesh(VIEW_DISTANCE * VIEW_DISTANCE * VIEW_DISTANCE * 8);
+    buildStats.meshedChunks += updateMesh(VIEW_DISTANCE * VIEW_DISTANCE * VIEW_DISTANCE * 8);
+    auto meshed = std::chrono::steady_clock::now();
+    buildStats.generationTime += std::chrono::duration<float, std::chrono::milliseconds::period>(generated - start).count();
+    buildStats.meshingTime += std::chrono::duration<float, std::chrono::milliseconds::period>(meshed - generated).count();
 
     // Upload the mesh of the chunks around the player
-    uploadMesh(VIEW_DISTANCE * VIEW_DISTANCE * VIEW_DISTANCE * 8);
+    uploadMesh(SIZE_MAX);
 }
 
-void World::tick()
+void World::settle()
+{
+    playerChunk = fromWorldPos(*playerPos);
+    deleteChunks();
+    loadAllChunks();
+    updateVoxelStats();
+}
+
+void World::updateVoxelStats()
+{
+    size_t bytes = 0, denseBytes = 0, lights = 0, total = 0;
+    for (auto &[pos, chunk] : chunks)
+    {
+        bytes += chunk->getVoxelBytes();
+        lights += chunk->getLightBytes();
+        total += chunk->getBytes();
+        if (!chunk->isSimple())
+            denseBytes += CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE * sizeof(Voxel);
+    }
+    voxelBytes = bytes;
+    denseVoxelBytes = denseBytes;
+    lightBytes = lights;
+    chunkBytes = total;
+}
+
+int World::runStage(int (World::*stage)(int), StageCost &cost, TickScheduler::clock::time_point deadline, int stagesLeft)
+{
+    // Share what is left of the budget between the remaining stages, unused time goes to the next ones
+    TickScheduler::clock::time_point start = TickScheduler::clock::now();
+    TickScheduler::clock::duration budget = (deadline - start) / stagesLeft;
+    int done = (this->*stage)(cost.chunksFor(budget));
+    cost.update(TickScheduler::clock::now() - start, done);
+    return done;
+}
+
+void World::tick(TickScheduler::clock::time_point deadline)
 {
     // Check if the player has moved to another chunk
     ChunkPos newPlayerChunk = fromWorldPos(*playerPos);
@@ -409,30 +775,54 @@ void World::tick()
     // Delete the chunks that are too far away from the player
     deleteChunks();
 
+    // The mesh format changed, build every mesh again
+    if (remeshRequested.exchange(false))
+    {
+        for (auto &[pos, chunk] : chunks)
+        {
+            if (chunk->getNeedsSideOcclusionUpdate())
+                continue; // Will be meshed once its side occlusion is known
+            chunk->setNeedsMeshUpdate(true);
+            addToMeshQueue(chunk);
+        }
+    }
+
     // log_debug("Player chunk : (%d, %d, %d)", getX(playerChunk), getY(playerChunk), getZ(playerChunk));
 
     // Load the chunks around the player
-    loadChunks(CHUNK_GEN_PER_TICK);
+    runStage(&World::loadChunks, loadCost, deadline, 3);
 
     // Update the side occlusion of the chunks around the player
-    updateSideOcclusion(CHUNK_MESH_PER_TICK);
+    runStage(&World::updateSideOcclusion, occlusionCost, deadline, 2);
 
     // Update the mesh of the chunks around the player
-    updateMesh(CHUNK_MESH_PER_TICK);
+    runStage(&World::updateMesh, meshCost, deadline, 1);
+
+    updateVoxelStats();
 
     nTicks++;
 }
 
-void World::graphicalTick(Shader *shader)
+void World::graphicalTick(Shader *shader, float previousFrameTime)
 {
     // Prevent the tick thread from deleting chunks while we're drawing
-    chunksMutex.lock();
+    {
+        profile_scope(LockWait);
+        chunksMutex.lock();
+    }
 
     // Discard chunks that are too far away from the player
     discardChunks();
 
-    // Upload the mesh of the chunks around the player
-    uploadMesh(CHUNK_GPU_UPLOAD_PER_FRAME);
+    // Upload the mesh of the chunks around the player, as much as the frame budget allows
+    auto uploadStart = std::chrono::steady_clock::now();
+    size_t uploaded = uploadMesh(uploadBudget.nextFrame(previousFrameTime));
+    uploadBudget.update(uploaded, std::chrono::duration<float>(std::chrono::steady_clock::now() - uploadStart).count());
+
+    // Render the shadow maps that are outdated
+    if (shadowCascades != nullptr)
+        shadowCascades->render(chunks, uploadedChunks);
+    uploadedChunks.clear();
 
     // Draw the chunks
     draw(shader);
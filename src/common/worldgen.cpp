@@ -13,12 +13,55 @@
                          : _x > _b ? _b\
                                    : _x; })
 #define voxel3d(x, y, z) voxels[(x) + CHUNK_SIZE * (y) + CHUNK_SIZE * CHUNK_SIZE * (z)]
+#define CLASSIC_AMPLITUDE 75 // in voxels
+#define CLASSIC_WATER_TOP -3  // world height of the highest water voxel
+
 int roundDown(float x)
 {
     return (int)x - (x < 0 && x != (int)x);
 }
 namespace WorldGenerator
 {
+    namespace
+    {
+        FastNoiseLite makeClassicNoise()
+        {
+            FastNoiseLite n;
+            n.SetNoiseType(FastNoiseLite::NoiseType_Perlin);
+            n.SetSeed(27012004);
+            n.SetFrequency(0.01);
+            n.SetFractalType(FastNoiseLite::FractalType_FBm);
+            n.SetFractalOctaves(2);
+            n.SetFractalLacunarity(2.0);
+            n.SetFractalGain(0.5);
+            n.SetFractalWeightedStrength(7.0);
+            return n;
+        }
+    } // namespace
+
+    int classicHeight(int x, int z)
+    {
+        // One per thread, the chunks are generated on the tick thread and the far terrain on the main thread
+        thread_local FastNoiseLite n = makeClassicNoise();
+        return roundDown(n.GetNoise((float)x, (float)z) * CLASSIC_AMPLITUDE - CLASSIC_AMPLITUDE / 10);
+    }
+
+    void classicSurface(int x, int z, float *height, Voxel *voxel)
+    {
+        int top = classicHeight(x, z) - 1;
+        if (top >= 0)
+            *voxel = Voxel::Grass;
+        else if (top >= CLASSIC_WATER_TOP)
+            *voxel = Voxel::Sand;
+        else
+        {
+            *voxel = Voxel::Water;
+            top = CLASSIC_WATER_TOP;
+        }
+        // The voxels are centered on their coordinates
+        *height = top + 0.5f;
+    }
+
     void singleBlock(ChunkPos pos, ChunkData voxels, Voxel *simpleChunkVoxel, bool *isSimpleChunk)
     {
         *isSimpleChunk = false;
@@ -103,30 +146,13 @@ namespace WorldGenerator
 
     void classic(ChunkPos pos, ChunkData voxels, Voxel *simpleChunkVoxel, bool *isSimpleChunk)
     {
-        FastNoiseLite n;
-        n.SetNoiseType(FastNoiseLite::NoiseType_Perlin);
-        n.SetSeed(27012004);
-        n.SetFrequency(0.01);
-        n.SetFractalType(FastNoiseLite::FractalType_FBm);
-        n.SetFractalOctaves(2);
-        n.SetFractalLacunarity(2.0);
-        n.SetFractalGain(0.5);
-        n.SetFractalWeightedStrength(7.0);
-
-        const int amplitude = 75;
-
         int chunkY = ChunkPosTools::getY(pos) * CHUNK_SIZE;
         int height[CHUNK_SIZE][CHUNK_SIZE];
         for (int x = 0; x < CHUNK_SIZE; x++)
         {
             for (int z = 0; z < CHUNK_SIZE; z++)
             {
-                height[x][z] = clamp(roundDown(n.GetNoise(
-                                                   (float)(x + CHUNK_SIZE * ChunkPosTools::getX(pos)),
-                                                   (float)(z + CHUNK_SIZE * ChunkPosTools::getZ(pos))) *
-                                                   amplitude -
-                                               amplitude / 10) -
-                                         chunkY,
+                height[x][z] = clamp(classicHeight(x + CHUNK_SIZE * ChunkPosTools::getX(pos), z + CHUNK_SIZE * ChunkPosTools::getZ(pos)) - chunkY,
                                      0, CHUNK_SIZE);
             }
         }
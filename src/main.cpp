@@ -3,24 +3,36 @@
 #include "testgl/logging.hpp"
 #include "learnopengl/Shaders.hpp"
 #include "testgl/sun.hpp"
+#include "testgl/profiler.hpp"
+#include "testgl/overlay.hpp"
+#include "testgl/frameuniforms.hpp"
+#include "testgl/deferred.hpp"
+#include "testgl/resolution.hpp"
+#include "testgl/shadercache.hpp"
+#include "testgl/headless.hpp"
+#include "testgl/pacing.hpp"
+#include "testgl/farterrain.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <thread>
 
 int main(int argc, char **argv)
 {
-    if (Window::initGLFW() != EXIT_SUCCESS)
+    auto startTime = std::chrono::steady_clock::now();
+    headless::Options headlessOptions = headless::parseArguments(argc, argv);
+    if (Window::initGLFW(headlessOptions.enabled) != EXIT_SUCCESS)
     {
         return EXIT_FAILURE;
     }
-    Window window(WINDOW_TITLE);
+    Window window(WINDOW_TITLE, headlessOptions.enabled ? HEADLESS_HEIGHT : WINDOW_HEIGHT, headlessOptions.enabled ? HEADLESS_WIDTH : WINDOW_WIDTH);
+    profiler::setThreadName("Main thread");
 
-    // Load the base shaders
+    // Load the base shaders, they are set up once the world is created so that the driver can compile them meanwhile
     log_debug("Loading shaders");
     Shader shader("../shaders/base.vert", "../shaders/base.frag"); // Relative to the build directory
-
-    // Setup the shader
-    ShaderData::setupMaterials(&shader);
+    // Same fragment shader, the vertices are expanded from one record per face
+    Shader pulledShader("../shaders/pulled.vert", "../shaders/base.frag");
 
     // Load the player
     log_debug("Loading player");
@@ -30,17 +42,89 @@ int main(int argc, char **argv)
 
     // Create the world
     log_debug("Creating world");
+    Chunk::brickStorage = !headlessOptions.dense;
     World world(player.getPositionPtr(), WorldGenerator::classic);
     if (GEN_ALL_CHUNKS_ON_START)
         world.loadAllChunks();
 
+    // Setup the shaders
+    ShaderData::setupMaterials(&shader);
+    ShaderData::setupMaterials(&pulledShader);
+
+    // Camera, time and light, written once per frame and shared by every program
+    FrameUniforms frameUniforms;
+    FrameUniforms::attach(&shader);
+    FrameUniforms::attach(&pulledShader);
+
     // Here comes the sun
     log_debug("Creating sun");
     Sun sun(&shader);
+    sun.setupShader(&pulledShader);
+
+    // Frame time graph, shown while the profiler is enabled
+    Overlay overlay;
+
+    // Skip the chunks hidden behind terrain
+    OcclusionCuller occlusionCuller;
+    world.setOcclusionCuller(&occlusionCuller);
+
+    // Lay down the depth before shading, toggled with F8
+    DepthPrepass depthPrepass;
+    world.setDepthPrepass(&depthPrepass);
+
+    // Sun shadows, toggled with F11
+    ShadowCascades shadowCascades(&frameUniforms);
+    ShadowCascades::attach(&shader);
+    ShadowCascades::attach(&pulledShader);
+    world.setShadowCascades(&shadowCascades);
+
+    // Off-screen target scaled to hold the frame time, toggled with F12
+    DynamicResolution resolution(Window::framebufferWidth, Window::framebufferHeight);
+    if (headlessOptions.enabled)
+    {
+        resolution.lockScale(1.0f); // Still rendered off-screen, but the same image on every run
+        DynamicResolution::enabled = true; // The surfaceless context has no default framebuffer to draw to
+    }
+
+    // G-buffer and lighting pass, toggled with F10
+    DeferredRenderer deferred(resolution.getMaxWidth(), resolution.getMaxHeight());
+    sun.setupShader(deferred.getLightingShader());
+    ShadowCascades::attach(deferred.getLightingShader());
+    for (int i = 0; i < DEFERRED_TEST_LIGHTS; i++)
+    {
+        // Spiral around the spawn, colors going around the hue wheel
+        float angle = i * 2.39996f;
+        float distance = 8.0f + i * 2.0f;
+        glm::vec3 color = 0.5f + 0.5f * glm::cos(angle + glm::vec3(0.0f, 2.09f, 4.19f));
+        deferred.addLight(player.getPosition() + glm::vec3(cos(angle) * distance, 2.0f, sin(angle) * distance), 16.0f, color);
+    }
+
+    // Heightmap clipmap past the loaded chunks, toggled with F1
+    FarTerrain farTerrain;
+    sun.setupShader(farTerrain.getShader());
+
+    // Create the tick thread, headless runs build the world on the main thread instead
+    std::thread tickThread;
+    if (!headlessOptions.enabled)
+    {
+        log_debug("Creating tick thread");
+        tickThread = std::thread(tick_thread, &world, &player, &window);
+    }
+    headless::FrameTimes frameTimes;
+    headless::ChunkStats chunkStats;
+    if (headlessOptions.enabled)
+    {
+        // Build the world around the start of the path once, outside of the frame times
+        headless::followPath(&player, 0);
+        auto buildStart = std::chrono::high_resolution_clock::now();
+        world.settle();
+        chunkStats.setBuildTime(std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - buildStart).count());
+    }
 
-    // Create the tick thread
-    log_debug("Creating tick thread");
-    std::thread tickThread(tick_thread, &world, &player, &window);
+    // When frames start, toggled with F2
+    if (headlessOptions.enabled)
+        FramePacer::mode = FramePacer::Uncapped;
+    FramePacer pacer;
 
     // Loop until the user closes the window
     log_debug("Starting main loop");
@@ -48,21 +132,52 @@ int main(int argc, char **argv)
     auto previousTime = std::chrono::high_resolution_clock::now();
     while (!window.shouldClose())
     {
+        pacer.beginFrame();
+
         // Calculate delta time
         auto currentTime = std::chrono::high_resolution_clock::now();
         float deltaTime = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - previousTime).count();
         previousTime = currentTime;
+        if (headlessOptions.enabled)
+            deltaTime = HEADLESS_FRAME_TIME; // Simulated, the run must not depend on the speed of the machine
+        profiler::beginFrame();
+        Chunk::drawCalls = 0;
+
+        // Read the input as late as possible, after the pacing wait and just before the camera is used
+        glfwPollEvents();
+        pacer.sampleInput();
+
+        // Follow the window size
+        resolution.resize(Window::framebufferWidth, Window::framebufferHeight);
+        deferred.resize(resolution.getMaxWidth(), resolution.getMaxHeight());
+        glm::mat4 projection = player.getProjectionMatrix(Window::framebufferWidth, Window::framebufferHeight);
+
+        // Headless runs build the world on the main thread, the frame time only covers the render that follows
+        if (headlessOptions.enabled)
+        {
+            headless::followPath(&player, frame_n - 1);
+            auto buildStart = std::chrono::high_resolution_clock::now();
+            world.settle();
+            chunkStats.addSettle(std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - buildStart).count());
+            if (frame_n % HEADLESS_EDIT_INTERVAL == 0)
+                chunkStats.addEdit(headless::editTerrain(&world, player.getPosition()));
+        }
+        else
+            player.processKeyboard(window, deltaTime);
+        auto renderStart = std::chrono::high_resolution_clock::now();
 
         // Render here
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        player.processKeyboard(window, deltaTime);
-        player.setupCameraTransform(&shader, WINDOW_WIDTH, WINDOW_HEIGHT);
-
-        // Set the player position in the shader
-        shader.use();
-        shader.setVec3("viewPos", player.getPosition());
-        shader.setFloat("time", (float)glfwGetTime());
+        resolution.beginFrame();
         sun.update(deltaTime, player.getPosition());
+        frameUniforms.setCamera(player.getViewMatrix(), projection, player.getPosition());
+        frameUniforms.setTime(headlessOptions.enabled ? frame_n * HEADLESS_FRAME_TIME : (float)glfwGetTime());
+        frameUniforms.setLightPosition(sun.getPosition());
+        frameUniforms.upload();
+        occlusionCuller.beginFrame();
+        depthPrepass.beginFrame();
+        shadowCascades.beginFrame(player.getPosition(), sun.getDirection());
+        farTerrain.update(player.getPosition());
 
         if (player.debugMode)
         {
@@ -73,20 +188,105 @@ int main(int argc, char **argv)
             glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
         }
 
-        world.graphicalTick(&shader);
+        // Behind everything, in the frame the deferred lighting pass keeps for the sky
+        farTerrain.draw(projection, player.getPosition());
+
+        if (DeferredRenderer::enabled)
+        {
+            deferred.beginGeometry(resolution.getWidth(), resolution.getHeight());
+            world.setPulledShader(deferred.getPulledGeometryShader());
+            world.graphicalTick(deferred.getGeometryShader(), deltaTime);
+            deferred.shade(player.getViewMatrix(), projection, resolution.getFramebuffer());
+        }
+        else
+        {
+            // The far terrain used its own depth range
+            if (FarTerrain::enabled)
+                glClear(GL_DEPTH_BUFFER_BIT);
+            world.setPulledShader(&pulledShader);
+            world.graphicalTick(&shader, deltaTime);
+        }
+        // Read before the upscale, from the off-screen target
+        if (headlessOptions.enabled && headlessOptions.hash && frame_n == headlessOptions.frames)
+        {
+            uint64_t hash;
+            if (headless::hashFramebuffer(resolution.getFramebuffer(), resolution.getWidth(), resolution.getHeight(), &hash))
+                log_info("Image hash %016llx", (unsigned long long)hash);
+        }
+        resolution.endFrame();
+        overlay.draw();
+
+        if (headlessOptions.enabled)
+        {
+            // Nothing is presented, wait for the GPU so that the frame time includes its work
+            glFinish();
+            // The first frames still fill the caches and the driver, unless the run is too short to skip them
+            if (frame_n > HEADLESS_WARMUP_FRAMES || headlessOptions.frames <= HEADLESS_WARMUP_FRAMES)
+                frameTimes.add(std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - renderStart).count());
+            chunkStats.addFrame(Chunk::drawCalls);
+            if (frame_n == headlessOptions.frames)
+                window.close();
+        }
 
         if (frame_n % 120 == 0)
         {
             // Print fps
             float fps = 1.0f / deltaTime;
             log_debug("FPS: %f", fps);
+            log_debug("Uploads: %.1f KiB/frame on average, %.1f KiB max, %d frame time spikes, %.1f MiB/s",
+                      world.uploadBudget.getAverageBytesPerFrame() / 1024.0f, world.uploadBudget.getMaxBytesPerFrame() / 1024.0f,
+                      world.uploadBudget.getSpikes(), world.uploadBudget.getThroughput() / (1024.0f * 1024.0f));
+            world.uploadBudget.resetStats();
+            log_debug("Visibility: %d/%d chunks reachable from the camera, %d chunk draw calls", world.getVisibleChunks(), world.getLoadedChunks(), Chunk::drawCalls);
+            if (OcclusionCuller::enabled)
+                log_debug("Occlusion: %d/%d chunks occluded (%d vertices skipped)", occlusionCuller.getOccludedChunks(),
+                          occlusionCuller.getTestedChunks(), occlusionCuller.getOccludedVertices());
+            log_debug("Voxels: %.2f MiB in %s, %.2f MiB as dense arrays", world.voxelBytes / (1024.0f * 1024.0f),
+                      Chunk::brickStorage ? "bricks" : "dense arrays", world.denseVoxelBytes / (1024.0f * 1024.0f));
+            log_debug("Light: %.2f MiB in bricks", world.lightBytes / (1024.0f * 1024.0f));
+            log_debug("Chunks: %.2f MiB in total, %.1f KiB per chunk", world.chunkBytes / (1024.0f * 1024.0f),
+                      world.chunkBytes / 1024.0f / std::max(1, world.getLoadedChunks()));
+            log_debug("Meshes: %.2f MiB for the %d visible faces (%s)", world.getVisibleMeshBytes() / (1024.0f * 1024.0f),
+                      world.getVisibleFaces(), Chunk::vertexPulling ? "vertex pulling" : "glDrawArrays");
+            for (int i = 0; i < SHADOW_CASCADES; i++)
+                log_debug("Shadow cascade %d: %d renders, %.3fms each on the GPU", i, shadowCascades.getCascadeRenders(i), shadowCascades.getCascadeTime(i));
+            shadowCascades.resetStats();
+            log_debug("Resolution: %dx%d (%.0f%%), GPU frame time %.2fms", resolution.getWidth(), resolution.getHeight(),
+                      resolution.getScale() * 100.0f, resolution.getGpuFrameTime() * 1000.0f);
+            log_debug("Pacing: %s, input to present %.2fms avg %.2fms max, frame time %.2fms +- %.2fms", FramePacer::modeNames[FramePacer::mode],
+                      pacer.getAverageLatency(FramePacer::mode), pacer.getMaxLatency(FramePacer::mode),
+                      pacer.getAverageFrameTime(FramePacer::mode), pacer.getJitter(FramePacer::mode));
+            if (OcclusionCuller::enabled)
+                log_debug("Shading: fragments not counted while occlusion culling is on (F6)");
+            else
+                log_debug("Shading: %u fragments with the depth pre-pass %s", depthPrepass.getShadedFragments(),
+                          DepthPrepass::enabled ? "enabled" : "disabled");
+            if (FarTerrain::enabled)
+                log_debug("Far terrain: %d heightmap samples computed", farTerrain.getUpdatedSamples());
+            farTerrain.resetStats();
+
+            if (profiler::enabled)
+            {
+                profiler::FrameStats stats = profiler::getAverageStats(120);
+                log_info("Frame %.2fms", stats.frame);
+                for (int stage = 0; stage < profiler::STAGE_COUNT; stage++)
+                    log_info("  %-20s cpu %6.3fms gpu %6.3fms", profiler::stageNames[stage], stats.cpu[stage], stats.gpu[stage]);
+            }
         }
         frame_n += 1;
+        profiler::endFrame(deltaTime);
         // Swap front and back buffers
         glfwSwapBuffers(window);
+        pacer.endFrame();
 
-        // Poll for and process events
-        glfwPollEvents();
+        if (frame_n == 2)
+        {
+            // Wait for the GPU once so that the first frame is really on screen
+            glFinish();
+            float elapsed = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - startTime).count();
+            log_info("First frame after %.0fms, %d programs loaded from the cache and %d compiled%s", elapsed,
+                     shader_cache::getHits(), shader_cache::getMisses(), shader_cache::isParallel() ? " in parallel" : "");
+        }
     }
 
     // Check if the tick thread is still running
@@ -96,6 +296,19 @@ int main(int argc, char **argv)
         tickThread.join();
     }
 
+    pacer.report();
+    if (headlessOptions.enabled)
+    {
+        frameTimes.report(headlessOptions.output);
+        chunkStats.report(&world);
+        headless::benchmarkBulkEdit(&world, player.getPosition());
+        headless::benchmarkRaycast(&world, player.getPosition());
+    }
+
+    // Do not lose a capture that is still running
+    if (profiler::isTracing())
+        profiler::stopTrace(TRACE_OUTPUT_PATH);
+
     return EXIT_SUCCESS;
 }
 
@@ -103,22 +316,18 @@ int main(int argc, char **argv)
 void tick_thread(World *world, Player *player, Window *window)
 {
     log_info("Tick thread started");
-    auto previousTime = std::chrono::system_clock::now();
+    profiler::setThreadName("Tick thread");
+    TickScheduler scheduler(TICKS_PER_SECOND);
+    std::vector<Player::VoxelPick> picks;
     while (!window->shouldClose())
     {
-        // Calculate delta time
-        auto currentTime = std::chrono::system_clock::now();
-        float deltaTime = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - previousTime).count();
-        previousTime = currentTime;
-
-        // Wait for the next tick
-        int delay = 1000 / TICKS_PER_SECOND - (int)(deltaTime * 1000);
-        if (delay > 0)
-            std::this_thread::sleep_for(std::chrono::milliseconds(delay));
-        else
-            log_warn("Tick took too long (%dms)", -delay);
-
-        world->tick();
+        // Wait for the next tick, or run it right away if we are late
+        TickScheduler::clock::time_point deadline = scheduler.beginTick();
+        // Break and place the voxels clicked since the last tick
+        player->takePicks(picks);
+        for (const Player::VoxelPick &pick : picks)
+            world->pickVoxel(pick.origin, pick.direction, pick.value);
+        world->tick(deadline);
     }
 
     log_info("Tick thread exiting");